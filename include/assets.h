@@ -3,8 +3,11 @@
 
 #include "array.h"
 #include "dynamic_string.h"
+#include "hash_map.h"
 #include "ints.h"
 #include "list.h"
+#include "quantize.h"
+#include "thread_pool.h"
 #include "vec2.h"
 #include "vec3.h"
 
@@ -16,13 +19,60 @@ struct face {
     struct vertex vertices[3];
 };
 
+// identifies a file no matter which path it was reached through
+struct file_id {
+    u64 dev, ino;
+};
+
+static inline u64
+file_id_hash(struct file_id* id) {
+    return hash_u64(id->ino ^ hash_u64(id->dev));
+}
+
+static inline bool
+file_id_equal(struct file_id* a, struct file_id* b) {
+    return a->dev == b->dev && a->ino == b->ino;
+}
+
+// returns false if there is no such file
+bool
+file_id_get(char* path, struct file_id* dest);
+
+static inline u64
+string_hash(string_t* s) {
+    return hash_bytes(s->data, s->len);
+}
+
+// enough for a 32768x32768 texture
+#define TEXTURE_MAX_LEVELS 16
+
+struct texture_level {
+    int width, height;
+    u8* pixels;
+};
+
 struct texture {
     int width, height;
     // this is how `stb_image` loads them, so we keep in this format of ARGB values
     u8* pixels;
 
+    // the texture itself followed by its mipmaps, each half the size of the one before it, down to 1x1. without
+    // mipmaps there is only the first one, which is the same as `width`, `height` and `pixels`
+    struct texture_level levels[TEXTURE_MAX_LEVELS];
+    int levels_len;
+
+    // when the texture was loaded from the cache, all the levels point into this read only mapping
+    void* cache;
+    size_t cache_len;
+
+    // textures are loaded in the background, the fields above are only valid once this is done. see
+    // `assets_manager_wait_texture()`
+    struct job_group loading;
+    struct assets_manager* manager;
+
     // we keep the file path here so we can reuse the material for multiple objects
     string_t path;
+    struct file_id id;
     // we also keep the ref count so we know when to drop it
     int ref_count;
 
@@ -41,6 +91,10 @@ struct material {
 
     // may be NULL
     struct texture* texture;
+    // only used by impostors, see `impostor.h`: texels of `texture` with an alpha of 0 are not drawn at all, and the
+    // normals come from this texture (in model space) instead of the faces. may be NULL
+    struct texture* normal_map;
+    bool alpha_test;
 
     // since a single mesh can have mulitple materials we keep all of them linked
     list_t link;
@@ -51,11 +105,34 @@ struct use_material {
     struct material* material;
 };
 
+// the keys point to the names of the materials themselves
+define_hash_map(string_t, struct material*, material_map, string_hash, string_equal);
+define_hash_map(struct file_id, struct texture*, texture_map, file_id_hash, file_id_equal);
+define_hash_map(struct file_id, struct mesh*, mesh_map, file_id_hash, file_id_equal);
+
 define_array(struct face, face_array);
 define_array(vec2, vec2_array);
 define_array(vec3, vec3_array);
+define_array(u16vec2, u16vec2_array);
+define_array(u16vec3, u16vec3_array);
+define_array(i16vec2, i16vec2_array);
 define_array(struct use_material, use_material_array);
 
+// a mesh has at most this many simplified versions of itself, each with about half the faces of the one before
+#define MESH_MAX_LODS 8
+
+// a simplified version of a mesh, made by collapsing its edges. it uses the same vertices, normals and texture
+// coordinates as the full mesh, just fewer of them: the vertices and normals are sorted so the ones a level uses come
+// first, so only the first `vertices_len` and `normals_len` of them have to be transformed to draw it
+struct mesh_lod {
+    face_array_t faces;
+    use_material_array_t use_materials;
+    int vertices_len, normals_len;
+
+    // roughly how far the surface moved from where it is in the full mesh, in the units of the vertices
+    float error;
+};
+
 struct mesh {
     vec3_array_t vertices;
     vec3_array_t normals;
@@ -63,27 +140,153 @@ struct mesh {
 
     face_array_t faces;
 
+    // with `quantized` set, the vertices, normals and texture coordinates are kept in these instead, and the arrays
+    // above are empty. a packed vertex or texture coordinate is `min + packed * scale` on each axis, and the normals
+    // are in octahedral form. see `mesh_quantize()`
+    bool quantized;
+    u16vec3_array_t packed_vertices;
+    i16vec2_array_t packed_normals;
+    u16vec2_array_t packed_textures;
+    vec3 vertices_min, vertices_scale;
+    vec2 textures_min, textures_scale;
+
+    // a sphere around all of the vertices, for culling
+    vec3 center;
+    float radius;
+
+    // from more to less detailed, see `mesh_get_lod()`
+    struct mesh_lod lods[MESH_MAX_LODS];
+    int lods_len;
+    // made by the renderer the first time it needs to draw the mesh from far away, NULL until then
+    struct impostor* impostor;
+
     list_t materials;
+    // the same materials by name, see `mesh_add_material()`
+    material_map_t materials_by_name;
     use_material_array_t use_materials;
 
     string_t path;
+    // the .mtl files the materials were loaded from
+    string_array_t material_libraries;
+
+    // when the mesh was loaded from the cache, its arrays point into this mapping instead of owning their memory (they
+    // all have a cap of 0), so they must not be grown. see `cache.h`
+    void* cache;
+    size_t cache_len;
+
     list_t link;
 };
 
 struct assets_manager {
+    // guards both of the lists and the reference counts of the textures, since assets are loaded on multiple threads
+    pthread_mutex_t lock;
     list_t meshes, textures;
+    // the same meshes and textures by the file they were loaded from
+    mesh_map_t meshes_by_id;
+    texture_map_t textures_by_id;
+    // whether textures get mipmaps, set from `RASTERIZER_TEXTURE_MIPMAPS`
+    bool texture_mipmaps;
+    // whether meshes get quantized, set from `RASTERIZER_QUANTIZE`
+    bool quantize_meshes;
+
+    // loads the assets, and splits up the work of loading a single one
+    struct thread_pool* pool;
 };
 
+// how many vertices, normals and texture coordinates the mesh has, whichever form they are kept in
+static inline int
+mesh_vertices_len(struct mesh* mesh) {
+    return mesh->quantized ? mesh->packed_vertices.len : mesh->vertices.len;
+}
+
+static inline int
+mesh_normals_len(struct mesh* mesh) {
+    return mesh->quantized ? mesh->packed_normals.len : mesh->normals.len;
+}
+
+static inline int
+mesh_textures_len(struct mesh* mesh) {
+    return mesh->quantized ? mesh->packed_textures.len : mesh->textures.len;
+}
+
+static inline vec2
+mesh_get_texture(struct mesh* mesh, int index) {
+    if(!mesh->quantized) {
+        return mesh->textures.data[index];
+    }
+
+    u16vec2 packed = mesh->packed_textures.data[index];
+    return (vec2){
+            mesh->textures_min.x + packed.x * mesh->textures_scale.x,
+            mesh->textures_min.y + packed.y * mesh->textures_scale.y,
+    };
+}
+
+// level 0 is the full mesh, and level `i` above that is `mesh->lods[i - 1]`. either way `dest` is just a view of the
+// mesh's own arrays
+static inline void
+mesh_get_lod(struct mesh* mesh, int level, struct mesh_lod* dest) {
+    if(level == 0) {
+        *dest = (struct mesh_lod){
+                .faces = mesh->faces,
+                .use_materials = mesh->use_materials,
+                .vertices_len = mesh_vertices_len(mesh),
+                .normals_len = mesh_normals_len(mesh),
+        };
+    } else {
+        *dest = mesh->lods[level - 1];
+    }
+}
+
+static inline struct texture_level*
+texture_last_level(struct texture* texture) {
+    return &texture->levels[texture->levels_len - 1];
+}
+
 struct assets_manager*
 assets_manager_create(void);
 
 void
 assets_manager_destroy(struct assets_manager* manager);
 
+// loads the mesh, along with all its materials and textures. loading the same file again gives back the same mesh
 struct mesh*
 assets_manager_load_mesh(struct assets_manager* manager, char* path);
 
+// a mesh that is being loaded in the background
+struct mesh_future;
+
+// starts loading the mesh on the manager's thread pool. every future has to be waited on, see `mesh_future_wait()`
+struct mesh_future*
+assets_manager_load_mesh_async(struct assets_manager* manager, char* path);
+
+// waits for the mesh to finish loading and frees the future. returns NULL if the mesh could not be loaded
+struct mesh*
+mesh_future_wait(struct mesh_future* future);
+
 void
 mesh_destroy(struct mesh* mesh);
 
+// not the smallest sphere around the vertices, but close enough: the center of their bounding box and the furthest
+// vertex from it
+void
+mesh_compute_bounds(struct mesh* mesh);
+
+// finds the texture among the ones already loaded, or starts loading it. either way the caller gets a reference to it,
+// which is dropped when the material using it is destroyed
+struct texture*
+assets_manager_get_texture(struct assets_manager* manager, string_t* path);
+
+// waits for the texture to finish loading, returns whether it succeeded
+bool
+assets_manager_wait_texture(struct assets_manager* manager, struct texture* texture);
+
+void
+material_destroy(struct material* material);
+
+// adds the material to the front of the mesh's materials, where it takes precedence over any earlier one with the same
+// name
+void
+mesh_add_material(struct mesh* mesh, struct material* material);
+
 #endif
@@ -1,6 +1,10 @@
 #ifndef BOX_H
 #define BOX_H
 
+#include <stdbool.h>
+
+#include "macros.h"
+
 struct box {
     int x, y, width, height;
 };
@@ -9,4 +13,23 @@ struct bounding_box {
     int start_x, start_y, end_x, end_y;
 };
 
+static inline bool
+box_is_empty(struct box *box) {
+    return box->width <= 0 || box->height <= 0;
+}
+
+static inline bool
+box_intersects(struct box *a, struct box *b) {
+    return a->x < b->x + b->width && b->x < a->x + a->width && a->y < b->y + b->height && b->y < a->y + a->height;
+}
+
+// the smallest box containing both
+static inline struct box
+box_union(struct box *a, struct box *b) {
+    int x = min(a->x, b->x), y = min(a->y, b->y);
+    int end_x = max(a->x + a->width, b->x + b->width), end_y = max(a->y + a->height, b->y + b->height);
+
+    return (struct box){x, y, end_x - x, end_y - y};
+}
+
 #endif
@@ -0,0 +1,40 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+
+#include "assets.h"
+#include "dynamic_string.h"
+
+// parsed assets are kept on disk in a binary form, so they can be mapped straight into memory next time instead of
+// being parsed again. a cache file is only used if the file it was made from (and everything that file depends on, like
+// the .mtl files of a mesh) still has the same size and modification time.
+//
+// by default the cache files sit next to their sources, with an extra extension. setting `RASTERIZER_CACHE_DIR` puts
+// them all in that directory instead, and setting it to an empty string turns the cache off
+
+// bump this whenever the layout of any cache file changes
+#define CACHE_VERSION 5
+
+// the path of the cache file for the given source, with `extension` appended. returns false if caching is turned off
+bool
+cache_path(char *source, char *extension, string_t *dest);
+
+// maps the cached form of the mesh at `path`, if there is an up to date one that is (or is not) quantized as requested
+struct mesh *
+mesh_cache_load(struct assets_manager *manager, char *path, bool quantized);
+
+// writes the mesh to the cache, returns whether it succeeded
+bool
+mesh_cache_store(struct mesh *mesh);
+
+// maps the decoded pixels of the texture at `texture->path` into its levels, if there is an up to date cache file with
+// (or without) mipmaps as requested. the mapping is shared, so processes using the same textures share the memory too
+bool
+texture_cache_load(struct texture *texture, bool mipmaps);
+
+// writes all the levels of the texture to the cache, returns whether it succeeded
+bool
+texture_cache_store(struct texture *texture);
+
+#endif
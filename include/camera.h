@@ -30,4 +30,7 @@ camera_update_viewport(struct camera *camera, int width, int height);
 void
 camera_update_orientation(struct camera *camera, float dx, float dy);
 
+void
+camera_set_orientation(struct camera *camera, float pitch, float yaw);
+
 #endif
@@ -0,0 +1,38 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "array.h"
+#include "camera.h"
+#include "vec3.h"
+
+// a camera pose for a single frame
+struct camera_key {
+    vec3 pos;
+    float pitch, yaw;
+};
+
+define_array(struct camera_key, camera_key_array);
+
+// a recorded sequence of camera poses, one per frame, that can be replayed for reproducible measurements. on disk it
+// is a text file with one `x y z pitch yaw` line per frame, where lines starting with `#` are ignored
+struct camera_path {
+    camera_key_array_t keys;
+};
+
+bool
+camera_path_load(struct camera_path *path, char *file);
+
+void
+camera_path_deinit(struct camera_path *path);
+
+void
+camera_path_apply(struct camera_path *path, int frame, struct camera *camera);
+
+// appends the current camera pose to a path file that is being recorded
+void
+camera_path_record(FILE *f, struct camera *camera);
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef COMMAND_BUFFER_H
+#define COMMAND_BUFFER_H
+
+#include <stdbool.h>
+
+#include "array.h"
+#include "assets.h"
+#include "camera.h"
+#include "scene.h"
+#include "vec3.h"
+
+// a frame as the renderer saw it once it went through the scene: which meshes it drew, with which level of detail and
+// where. drawing the commands again skips the scene, the culling of whole meshes and picking the levels of detail, so
+// it is the exact same work every time, see `render_commands()`
+
+// a single mesh to draw, same as a `struct scene_draw` that was not culled
+struct render_command {
+    struct mesh *mesh;
+    // see `mesh_get_lod()`, and one past the simplest level for the impostor
+    int lod;
+    struct transform transform;
+    // multiplies the color of the mesh, only when `tinted`
+    vec3 tint;
+    bool tinted;
+};
+
+define_array(struct render_command, render_command_array);
+
+struct command_buffer {
+    render_command_array_t commands;
+
+    // where the camera was when the commands were recorded
+    vec3 pos;
+    float pitch, yaw, fov;
+    int width, height;
+};
+
+void
+command_buffer_deinit(struct command_buffer *buffer);
+
+// puts the camera where it was when the commands were recorded, the viewport is up to whoever draws them
+void
+command_buffer_apply_camera(struct command_buffer *buffer, struct camera *camera);
+
+// meshes are stored by the path they were loaded from, so commands for meshes without one, like those of polygons, are
+// left out. returns whether it succeeded
+bool
+command_buffer_write(struct command_buffer *buffer, char *path);
+
+// loads the meshes the commands use through the manager. returns whether it succeeded
+bool
+command_buffer_read(struct command_buffer *buffer, struct assets_manager *manager, char *path);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <stdbool.h>
+
+#include "camera.h"
+#include "command_buffer.h"
+#include "ints.h"
+#include "render.h"
+#include "scene.h"
+
+// a plain in-memory render target, for when there is no window to draw into
+struct framebuffer {
+    int width, height;
+
+    // same ARGB layout as the window buffers
+    u32 *pixels;
+    float *depth;
+
+    // see `renderer->stats` for the stats of the last frame
+    struct renderer *renderer;
+};
+
+struct framebuffer *
+framebuffer_create(int width, int height);
+
+void
+framebuffer_destroy(struct framebuffer *framebuffer);
+
+// note: this also updates the camera viewport to match the framebuffer
+void
+framebuffer_render(struct framebuffer *framebuffer, struct scene_tree *scene, struct camera *camera);
+
+// same as `framebuffer_render()`, see `render_record()`
+void
+framebuffer_record(struct framebuffer *framebuffer, struct scene_tree *scene, struct camera *camera,
+        struct command_buffer *dest);
+
+// see `render_commands()`, this too updates the camera viewport
+void
+framebuffer_render_commands(struct framebuffer *framebuffer, struct command_buffer *commands, struct camera *camera);
+
+bool
+framebuffer_write_ppm(struct framebuffer *framebuffer, char *path);
+
+bool
+framebuffer_write_png(struct framebuffer *framebuffer, char *path);
+
+// picks the format from the extension of the path, defaulting to ppm
+bool
+framebuffer_write(struct framebuffer *framebuffer, char *path);
+
+#endif
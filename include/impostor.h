@@ -0,0 +1,57 @@
+#ifndef IMPOSTOR_H
+#define IMPOSTOR_H
+
+#include "assets.h"
+#include "vec2.h"
+#include "vec3.h"
+
+// an impostor is a mesh drawn ahead of time from a number of directions, so from far enough away it can be drawn as a
+// single textured quad instead, showing the picture taken from the direction closest to the camera's.
+//
+// the pictures are taken around the y axis, which is up in .obj files, at a few heights from the side to above. the
+// colors are stored without lighting and with the normals of the surface next to them, so the quad can still be lit
+// the same way as the mesh itself no matter how it is rotated
+
+// the width and height of a single picture in texels
+#define IMPOSTOR_TILE_SIZE 64
+// how many pictures are taken around the mesh, and at how many different heights
+#define IMPOSTOR_YAWS 8
+#define IMPOSTOR_PITCHES 2
+#define IMPOSTOR_VIEWS (IMPOSTOR_YAWS * IMPOSTOR_PITCHES)
+// the pictures are kept side by side in this many columns
+#define IMPOSTOR_ATLAS_COLUMNS 4
+
+struct impostor_view {
+    // from the center of the mesh towards where the picture was taken from, and then the axes of the picture going
+    // right and up, all in model space
+    vec3 direction, right, up;
+
+    // the corners of the picture in the textures
+    vec2 uv_min, uv_max;
+};
+
+struct impostor {
+    struct impostor_view views[IMPOSTOR_VIEWS];
+    // half the width of a picture, in the units of the mesh. the pictures are centered on the bounding sphere
+    float half_size;
+
+    // the colors, where the alpha is 0 for texels the mesh does not cover, and the normals mapped from [-1, 1] to
+    // [0, 255], with an alpha of 0 for texels whose surface has no normal
+    struct texture colors, normals;
+    // textured with both of the above, see `struct material`
+    struct material material;
+};
+
+// draws the pictures of the mesh, using a renderer of its own
+struct impostor *
+impostor_create(struct mesh *mesh);
+
+void
+impostor_destroy(struct impostor *impostor);
+
+// the index of the picture taken from the direction closest to the given one, which is in model space and does not
+// need to be normalized
+int
+impostor_select_view(struct impostor *impostor, vec3 direction);
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include "ints.h"
+#include "quantize.h"
+#include "vec2.h"
+#include "vec3.h"
+
+// a pixel that passed both the coverage and the depth test, waiting to be shaded
+struct fragment {
+    int index;
+    float alpha, beta, gamma;
+    float depth;
+};
+
+// the edge functions of a triangle in screen space, set up so that `a * (x - ox) + b * (y - oy)` directly gives the
+// barycentric coordinate of the pixel at (x, y) for each of the three vertices
+struct triangle_setup {
+    float a[3], b[3];
+    float ox[3], oy[3];
+    float depths[3];
+};
+
+// the innermost loops of the renderer. they are compiled once for every instruction set we know of, and the best one
+// the cpu supports is picked at startup, see `kernels_get()`
+struct render_kernels {
+    char *name;
+
+    // fills `len` pixels with `color`, and their depth with infinity
+    void (*clear)(u32 *buffer, float *depth_buffer, int len, u32 color);
+
+    // transforms the points by the 3x4 matrix `m` and divides the result by its z, giving screen coordinates once the
+    // center `(cx, cy)` is added. the z is written to `depths` unchanged
+    void (*project)(float m[3][4], float cx, float cy, vec3 *points, vec2 *screen, float *depths, int len);
+
+    // multiplies the vectors by the 3x3 matrix `m`
+    void (*transform)(mat3 *m, vec3 *vectors, vec3 *dest, int len);
+
+    // the same two for the packed vertices and normals of a quantized mesh, decoding them on the way. the points are
+    // taken as they are, so `m` has to include going from the packed integers to the mesh's own units. the normals come
+    // out of the octahedral form without being normalized, see `octahedral_decode()`
+    void (*project_packed)(float m[3][4], float cx, float cy, u16vec3 *points, vec2 *screen, float *depths, int len);
+    void (*transform_octahedral)(mat3 *m, i16vec2 *vectors, vec3 *dest, int len);
+
+    // tests the pixels [start_x, end_x) of row `y` against the triangle and the depth buffer row, writing a fragment
+    // for every one that is covered and in front. returns the number of fragments written
+    int (*coverage)(struct triangle_setup *setup, int y, int start_x, int end_x, float *depth_row, int row_index,
+            struct fragment *dest);
+};
+
+// picks the best kernels for this cpu the first time it is called. setting `RASTERIZER_ISA` to the name of one of the
+// variants overrides the choice, if the cpu supports it. x86 builds have `sse2`, `avx2` and `avx512`, and every other
+// architecture only has `generic`
+const struct render_kernels *
+kernels_get(void);
+
+#endif
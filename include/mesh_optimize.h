@@ -0,0 +1,20 @@
+#ifndef MESH_OPTIMIZE_H
+#define MESH_OPTIMIZE_H
+
+#include "assets.h"
+
+// rearranges a freshly parsed mesh so it is cheaper to render, without changing what it looks like. exported meshes
+// tend to repeat the same positions, normals and texture coordinates and list their faces in whatever order the
+// modelling tool kept them, so:
+//
+// - bitwise equal positions, normals and texture coordinates are welded into one, and faces that end up with the same
+//   position twice are dropped since they have no area
+// - the faces using each material are reordered with tipsify, so faces sharing vertices are drawn close together
+// - the vertices are renumbered in the order the faces first use them, dropping the ones no face uses
+//
+// the arrays of the mesh have to own their memory, so this is done before the mesh goes to the cache, never after it
+// was loaded from there
+void
+mesh_optimize(struct mesh *mesh);
+
+#endif
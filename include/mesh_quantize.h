@@ -0,0 +1,20 @@
+#ifndef MESH_QUANTIZE_H
+#define MESH_QUANTIZE_H
+
+#include "assets.h"
+
+// packs the vertices, normals and texture coordinates of the mesh into 16 bits per component, which takes them from
+// 32 bytes to 14 per vertex, normal and texture coordinate together:
+//
+// - the vertices as fixed point within the bounding box of the mesh, so the error is at most half a 65535th of its size
+//   on each axis. the bounding sphere is grown to still hold them
+// - the normals in octahedral form, see `octahedral_encode()`, which is good to within a few thousandths of a degree
+// - the texture coordinates as fixed point within their own bounding box
+//
+// the renderer decodes the vertices and normals while transforming them, see `struct render_kernels`. the faces keep
+// their indices as they are, so the lods of the mesh stay valid. same as `mesh_optimize()`, this is done before the
+// mesh goes to the cache, never on a mesh loaded from there
+void
+mesh_quantize(struct mesh *mesh);
+
+#endif
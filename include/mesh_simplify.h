@@ -0,0 +1,17 @@
+#ifndef MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+#include "assets.h"
+
+// meshes with fewer faces than this are not simplified any further, they are cheap enough as they are
+#define MESH_LOD_MIN_FACES 64
+
+// fills `mesh->lods` with versions of the mesh that have about a half, a quarter, ... of its faces, using the quadric
+// error metric of garland and heckbert. every edge collapse moves one vertex onto the other, so no new vertices are
+// made. the vertices and normals of the mesh get renumbered along the way, see `struct mesh_lod`.
+//
+// same as `mesh_optimize()`, this is done before the mesh goes to the cache, never on a mesh loaded from there
+void
+mesh_build_lods(struct mesh *mesh);
+
+#endif
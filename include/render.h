@@ -1,11 +1,181 @@
 #ifndef RENDER_H
 #define RENDER_H
 
+#include <stdio.h>
+
+#include "box.h"
 #include "camera.h"
+#include "command_buffer.h"
 #include "ints.h"
+#include "kernels.h"
 #include "scene.h"
+#include "thread_pool.h"
+
+// the renderer keeps track of per frame counters and of how long each stage of the pipeline took. this costs a few
+// timestamps per triangle, so it can be compiled out by setting this to 0
+#ifndef RENDER_PROFILE
+#define RENDER_PROFILE 1
+#endif
+
+// a mesh only goes to a simpler level of detail once its error on screen is this much of `renderer->lod_pixels`, and
+// back as soon as it is over all of it, so it does not keep switching when it is right at the threshold
+#ifndef RENDER_LOD_HYSTERESIS
+#define RENDER_LOD_HYSTERESIS 0.75f
+#endif
+
+// how many slices the draws of a scene are split into per thread
+#ifndef RENDER_SLICES_PER_THREAD
+#define RENDER_SLICES_PER_THREAD 4
+#endif
+
+// how many separate boxes the damage of a frame is kept as, past that the ones that are the closest get merged
+#ifndef RENDER_DAMAGE_MAX
+#define RENDER_DAMAGE_MAX 8
+#endif
+
+enum render_stage {
+    RENDER_STAGE_CLEAR,
+    // going through the draws of the scene, i.e. everything that is not one of the per face stages below
+    RENDER_STAGE_TRAVERSAL,
+    // fetching, transforming and projecting the vertices. this and the culling part of the setup run on several threads
+    // and are added up over all of them
+    RENDER_STAGE_TRANSFORM,
+    // culling and bounding box setup
+    RENDER_STAGE_SETUP,
+    // finding the pixels covered by a triangle and depth testing them
+    RENDER_STAGE_COVERAGE,
+    // texturing, lighting and writing out the pixels that passed
+    RENDER_STAGE_SHADING,
+    RENDER_STAGE_COUNT,
+};
+
+// with `RENDER_PROFILE` disabled all of these stay zeroed
+struct render_stats {
+    // how many frames these are for, since they can be accumulated over multiple frames
+    int frames;
+
+    // faces that went into the pipeline, what happened to them, and the ones that were left after culling
+    u64 triangles_submitted;
+    u64 triangles_frustum_culled;
+    u64 triangles_backface_culled;
+    u64 triangles_zero_area;
+    u64 triangles_rasterized;
+
+    // pixels inside the bounding boxes of the rasterized triangles, the ones of those that were covered and in front
+    // of what was already drawn, and the ones that were written in the end
+    u64 pixels_tested;
+    u64 pixels_depth_passed;
+    u64 pixels_shaded;
+
+    double stage_ms[RENDER_STAGE_COUNT];
+    double frame_ms;
+};
+
+enum render_view {
+    // the normal, textured and lit image
+    RENDER_VIEW_SHADED,
+    // every pixel colored by how many times it was shaded, from blue for once to red and then white for a lot
+    RENDER_VIEW_OVERDRAW,
+    // the colors of the surfaces without any lighting
+    RENDER_VIEW_ALBEDO,
+    // the normals of the surfaces mapped from [-1, 1] to [0, 255], and black where there are none
+    RENDER_VIEW_NORMALS,
+};
+
+// the parts of a buffer that changed, e.g. since it was last drawn into. the boxes never overlap, and none of them at
+// all means nothing changed
+struct render_damage {
+    struct box boxes[RENDER_DAMAGE_MAX];
+    int len;
+};
+
+// state that is kept between frames, so it does not have to be reallocated for every one
+struct renderer {
+    enum render_view view;
+    const struct render_kernels* kernels;
+    // how many pixels the surface of a mesh may be off by when a simplified version of it is drawn, from
+    // `RASTERIZER_LOD_PIXELS` and 1 by default. 0 always draws the full meshes
+    float lod_pixels;
+    // meshes whose bounding sphere has a smaller radius than this many pixels are drawn as impostors, no matter how
+    // far their levels of detail are off. meshes too small to have any levels of detail never are. from
+    // `RASTERIZER_IMPOSTOR_PIXELS`, and half of `IMPOSTOR_TILE_SIZE` by default so a texel of the impostor is about a
+    // pixel. 0 turns impostors off
+    float impostor_pixels;
+
+    // scratch space for the fragments of a single triangle
+    struct fragment* fragments;
+    int fragments_cap;
+
+    // how many threads go through the draws of the scene, culling and transforming them, from `RASTERIZER_THREADS`
+    // and one per cpu by default. the pool is only made for the first frame, and never with a single thread
+    int threads;
+    struct thread_pool* pool;
+    // the draws as they were split up in the last frame, kept around for their buffers. see `render.c`
+    struct render_slice* slices;
+    int slices_len;
+
+    // whether the last frame had something stand in for what is ready by now, like an impostor that was only made
+    // afterwards. the same frame would look different when drawn again
+    bool stale;
+    // per pixel shading counts for `RENDER_VIEW_OVERDRAW`
+    u16* overdraw;
+    int overdraw_len;
+
+    // of the last rendered frame
+    struct render_stats stats;
+};
+
+struct renderer*
+renderer_create(void);
+
+void
+renderer_destroy(struct renderer* renderer);
+
+void
+renderer_set_view(struct renderer* renderer, enum render_view view);
+
+// `scene` has to be the root of a scene, see `struct scene_draw`
+void
+render(struct renderer* renderer, struct scene_tree* scene, struct camera* camera, u32* buffer, float* depth_buffer);
+
+// same as `render()`, and also keeps every draw that was not culled in `dest` together with the level of detail it was
+// drawn with, in the order they were drawn in. the meshes are not copied, so the commands are only good for as long as
+// the meshes of the scene are around
+void
+render_record(struct renderer* renderer, struct scene_tree* scene, struct camera* camera, u32* buffer,
+        float* depth_buffer, struct command_buffer* dest);
+
+// draws recorded commands again exactly as they are, without culling them or picking their levels of detail. the
+// camera does not have to be the one they were recorded with, see `command_buffer_apply_camera()`
+void
+render_commands(struct renderer* renderer, struct command_buffer* commands, struct camera* camera, u32* buffer,
+        float* depth_buffer);
+
+// same as `render()`, but only clears and draws the pixels inside the damage, the rest of the buffers are left as they
+// are. the pixels that are drawn come out exactly the same as with `render()`
+void
+render_damaged(struct renderer* renderer, struct scene_tree* scene, struct camera* camera, u32* buffer,
+        float* depth_buffer, struct render_damage* damage);
+
+// adds the box to the damage, merging it with every box it overlaps
+void
+render_damage_add(struct render_damage* damage, struct box box);
+
+void
+render_damage_add_all(struct render_damage* dest, struct render_damage* other);
+
+// adds the pixels a bounding sphere in world space might cover from the camera, see `struct scene_damage`
+void
+render_damage_add_sphere(struct render_damage* damage, struct camera* camera, vec3 center, float radius);
+
+char*
+render_stage_name(enum render_stage stage);
+
+void
+render_stats_accumulate(struct render_stats* dest, struct render_stats* other);
 
+// prints a single line with the per frame averages
 void
-render(struct scene_tree* scene, struct camera* camera, u32* buffer, float* depth_buffer);
+render_stats_print(FILE* f, struct render_stats* stats);
 
 #endif
@@ -0,0 +1,115 @@
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "camera.h"
+#include "ints.h"
+#include "render.h"
+#include "state.h"
+
+// the most buffers that can be handed to the render thread at once; matches the size of the window's buffer pool
+#define RENDER_THREAD_MAX_TARGETS 3
+
+// a buffer to draw a frame into. `handle` is opaque to the render thread, it only gets passed back with the finished
+// frame so the caller knows which of its buffers it is
+struct render_target {
+    void *handle;
+    u32 *data;
+    int width, height;
+
+    // once the frame is finished, the pixels that changed since the frame before it
+    struct render_damage damage;
+};
+
+// when a buffer was last drawn into, see `struct render_thread`
+struct render_thread_age {
+    void *handle;
+    u64 frame;
+};
+
+struct render_thread {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+
+    struct state *g;
+
+    // buffers that were handed over and are waiting to be drawn into
+    struct render_target pending[RENDER_THREAD_MAX_TARGETS];
+    int pending_len;
+
+    // finished frames, oldest first, waiting to be presented
+    struct render_target ready[RENDER_THREAD_MAX_TARGETS];
+    int ready_len;
+
+    // the buffer currently being drawn into, valid only while `busy` is set
+    struct render_target current;
+    bool busy;
+
+    bool running;
+
+    // whether something changed that the next frame should show, see `render_thread_invalidate()`. nothing is drawn
+    // while it is not set
+    bool invalidated;
+
+    // only ever touched by the render thread itself
+    struct renderer *renderer;
+    float *depth_buffer;
+    int depth_width, depth_height;
+    struct timespec last_frame;
+    bool has_last_frame;
+    // what the last finished frame showed, a frame that would come out the same is skipped
+    struct camera last_camera;
+    enum render_view last_view;
+    u32 last_version;
+    bool has_last_camera;
+    // how many frames were drawn so far, the damage of the last few of them by `frames % RENDER_THREAD_MAX_TARGETS`,
+    // and in which frame every buffer was drawn into last. a buffer only has the pixels redrawn that changed since
+    // then. the ages are also cleared by `render_thread_drain()`, while nothing is being drawn
+    u64 frames;
+    struct render_damage history[RENDER_THREAD_MAX_TARGETS];
+    struct render_thread_age ages[RENDER_THREAD_MAX_TARGETS];
+    // accumulated since they were last printed
+    struct render_stats stats;
+};
+
+struct render_thread *
+render_thread_create(struct state *g);
+
+void
+render_thread_destroy(struct render_thread *thread);
+
+// asks for a new frame, after something that shows up in it changed. the camera being moved by the pressed keys and the
+// scene changing are picked up by the render thread, but only once it was woken up by this
+void
+render_thread_invalidate(struct render_thread *thread);
+
+// whether there is nothing left to draw or present until the next `render_thread_invalidate()`
+bool
+render_thread_is_idle(struct render_thread *thread);
+
+// whether the given buffer is currently held anywhere in the pipeline
+bool
+render_thread_owns(struct render_thread *thread, void *handle);
+
+void
+render_thread_submit(struct render_thread *thread, struct render_target *target);
+
+// takes the newest finished frame, if there is one. older finished frames are stale by now so they are given back to
+// be drawn into again
+bool
+render_thread_take_ready(struct render_thread *thread, struct render_target *dest);
+
+// same as `render_thread_take_ready()`, but blocks until a frame is finished
+void
+render_thread_wait_ready(struct render_thread *thread, struct render_target *dest);
+
+// waits for the frame in progress to finish and then forgets about all the buffers it was handed, e.g. because they
+// are about to be destroyed
+void
+render_thread_drain(struct render_thread *thread);
+
+#endif
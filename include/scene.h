@@ -1,13 +1,19 @@
 #ifndef SCENE_H
 #define SCENE_H
 
+#include <stdbool.h>
+
 #include "array.h"
+#include "assets.h"
+#include "ints.h"
+#include "pool.h"
 #include "vec3.h"
 
 enum scene_node_type {
     SCENE_NODE_TYPE_MESH,
     SCENE_NODE_TYPE_POLYGON,
     SCENE_NODE_TYPE_TREE,
+    SCENE_NODE_TYPE_INSTANCES,
 };
 
 struct transform {
@@ -19,30 +25,123 @@ struct transform {
 void
 transform_default(struct transform *dest);
 
+// places `child`, which is relative to `parent`, in the space `parent` is relative to. `dest` may not be either of them
+void
+transform_compose(struct transform *parent, struct transform *child, struct transform *dest);
+
+// nodes are kept in a pool per type, so they never move and the ones of the same type stay close together in memory
 struct scene_node {
     // use this fiels and `container_of()` macro to retrive the appropriate structure
     enum scene_node_type type;
     struct scene_tree *parent;
+    // where it is in the children of the parent
+    int child_index;
 
+    // relative to the parent
     struct transform transform;
+
+    // relative to the root of the scene, see `scene_node_get_world_transform()`. when a node is dirty, so is every node
+    // below it
+    struct transform world;
+    bool dirty;
 };
 
+// a flat polygon, convex or concave, drawn in plain white and lit like any other surface. same as the faces of a mesh,
+// it is seen from the side its vertices go around counter clockwise
 struct scene_polygon {
     struct scene_node node;
+
+    // cut into triangles once when the polygon is added, with a single normal and texture coordinate for all of its
+    // vertices. the texture coordinate is only there so the faces get shaded with `material`, which is white
+    struct mesh mesh;
+    struct material material;
+    // same as in `struct scene_mesh`
+    int draw_index;
 };
 
 struct scene_mesh {
     struct scene_node node;
 
     struct mesh *mesh;
+    // where it is in the draws of the root of its scene, -1 when it is not in a scene
+    int draw_index;
 };
 
+// a single placement of the mesh of a `struct scene_instances`, relative to the node itself
+struct scene_instance {
+    struct transform transform;
+    // multiplies the color of the mesh
+    vec3 tint;
+    // same as in `struct scene_mesh`
+    int draw_index;
+};
+
+define_array(struct scene_instance, scene_instance_array);
+
+// draws the same mesh many times over, without a node for every copy
+struct scene_instances {
+    struct scene_node node;
+
+    struct mesh *mesh;
+    scene_instance_array_t instances;
+};
+
+// everything the renderer needs to draw a single mesh node, polygon or instance, so it never has to walk the tree. the
+// root of a scene keeps these in a flat array that is updated as nodes are added, moved and removed
+struct scene_draw {
+    struct mesh *mesh;
+    struct transform world;
+    // the bounding sphere of the mesh in world space, every draw is culled against it as a whole
+    vec3 center;
+    float radius;
+
+    // multiplies the color of the mesh, only when `tinted` so the others do not pay for it
+    vec3 tint;
+    bool tinted;
+
+    // the level of detail it was drawn with last time, see `struct mesh_lod`
+    int lod;
+
+    // the world transform and bounds are stale, see `scene_update_draws()`
+    bool dirty;
+    // whether the bounds were ever computed, a new draw was not drawn anywhere yet
+    bool placed;
+    // the node it belongs to, and which of its instances it is, or -1 for a mesh node
+    struct scene_node *node;
+    int instance;
+};
+
+define_array(struct scene_draw, scene_draw_array);
+
+// a bounding sphere in world space that a draw was drawn in before it changed, or is going to be drawn in after
+struct scene_damage {
+    vec3 center;
+    float radius;
+};
+
+define_array(struct scene_damage, scene_damage_array);
+
+// past this many spheres the damage is not worth keeping track of one by one anymore
+#define SCENE_DAMAGE_MAX 256
+
 define_array(struct scene_node *, scene_node_ptr_array);
 
 struct scene_tree {
     struct scene_node node;
 
     scene_node_ptr_array_t children;
+
+    // only used by trees without a parent, for all the meshes below them. the order is not the order of the tree
+    scene_draw_array_t draws;
+    // whether any of the draws might be dirty
+    bool draws_dirty;
+    // changes whenever something that shows up in a frame does, i.e. a draw was added, removed, moved or tinted. also
+    // only used by trees without a parent, so whoever draws the scene can tell whether it changed since last time
+    u32 version;
+    // where those changes happened since the damage was last cleared, as of the last `scene_update_draws()`. past
+    // `SCENE_DAMAGE_MAX` spheres only `damage_all` is set instead
+    scene_damage_array_t damage;
+    bool damage_all;
 };
 
 struct scene_polygon *
@@ -54,6 +153,16 @@ scene_add_mesh(struct scene_tree *parent, struct mesh *mesh);
 struct scene_tree *
 scene_add_tree(struct scene_tree *parent);
 
+struct scene_instances *
+scene_add_instances(struct scene_tree *parent, struct mesh *mesh);
+
+// adds an instance with the given placement, same as the `scene_node_set_*()` functions, and returns its index
+int
+scene_instances_add(struct scene_instances *instances, vec3 pos, vec3 rot, float scale);
+
+void
+scene_instances_set_tint(struct scene_instances *instances, int index, vec3 tint);
+
 void
 scene_node_set_position(struct scene_node *node, vec3 pos);
 
@@ -67,7 +176,33 @@ scene_node_set_scale(struct scene_node *node, float scale);
 void
 scene_node_reparent(struct scene_node *node, struct scene_tree *parent);
 
+// computes the world transform of the node again if it or any of its parents changed since the last time, so a scene
+// where nothing moves costs no transform math at all
+struct transform *
+scene_node_get_world_transform(struct scene_node *node);
+
+// brings the world transforms and bounds of the dirty draws of a scene up to date, `root` has to be without a parent
+void
+scene_update_draws(struct scene_tree *root);
+
+// forgets about the damage so far, once whoever draws the scene took it into account
+void
+scene_clear_damage(struct scene_tree *root);
+
 void
 scene_node_remove(struct scene_node *node);
 
+// refers to a node without holding on to it, for whoever might outlive the node
+struct scene_handle {
+    enum scene_node_type type;
+    struct pool_handle pool;
+};
+
+struct scene_handle
+scene_node_get_handle(struct scene_node *node);
+
+// the node the handle refers to, or NULL if it was removed since, even when another node took its place
+struct scene_node *
+scene_node_from_handle(struct scene_handle handle);
+
 #endif
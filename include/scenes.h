@@ -0,0 +1,15 @@
+#ifndef SCENES_H
+#define SCENES_H
+
+#include <stdbool.h>
+
+#include "assets.h"
+#include "camera.h"
+#include "scene.h"
+
+// builds one of the predefined scenes by name into `scene`, loading its meshes through `assets`. the camera is moved
+// to the scene's starting point. returns false if there is no such scene or one of its meshes failed to load
+bool
+scenes_load(char *name, struct scene_tree *scene, struct assets_manager *assets, struct camera *camera);
+
+#endif
@@ -1,7 +1,9 @@
 #ifndef STATE_H
 #define STATE_H
 
+#include <pthread.h>
 #include <stdbool.h>
+#include <stdio.h>
 
 struct keys {
     bool w, a, s, d;
@@ -15,9 +17,21 @@ struct state {
     struct assets_manager *assets;
 
     struct window *window;
-    float *depth_buffer;
 
     struct keys is_pressed;
+
+    // draw the overdraw heatmap instead of the normal image, toggled with the `o` key
+    bool show_overdraw;
+
+    // guards `camera`, `is_pressed` and `show_overdraw`, which are updated by the event thread and sampled by the
+    // render thread at the start of each frame
+    pthread_mutex_t lock;
+
+    // if set, the camera pose of every frame is appended here, see `camera_path.h`
+    FILE *camera_record;
+
+    // if not zero, the render stats are averaged and printed every this many frames
+    int profile_every;
 };
 
 #endif
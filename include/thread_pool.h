@@ -0,0 +1,67 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "array.h"
+
+// a job gets the data it was submitted with and its index, so the same function can be run over a range of work
+typedef void (*job_fn_t)(void *data, int index);
+
+struct job {
+    job_fn_t fn;
+    void *data;
+    int index;
+    struct job_group *group;
+};
+
+define_array(struct job, job_array);
+
+// a set of jobs that can be waited on together. it has to stay alive until `thread_pool_wait()` returns
+struct job_group {
+    // guarded by the pool's mutex
+    int pending;
+};
+
+struct thread_pool {
+    pthread_mutex_t mutex;
+    // signaled when a job is submitted, or when the pool is shutting down
+    pthread_cond_t has_jobs;
+    // signaled when the last job of any group finishes
+    pthread_cond_t done;
+
+    // a fifo of jobs waiting to be picked up, starting at `head`
+    job_array_t jobs;
+    int head;
+
+    pthread_t *threads;
+    int threads_len;
+    bool running;
+};
+
+// creates a pool with the given number of worker threads, or one for each cpu if it is 0. note that whoever waits on a
+// group also runs jobs in the meantime, so a pool with 0 workers still works, it is just not parallel
+struct thread_pool *
+thread_pool_create(int threads);
+
+// waits for all submitted jobs to finish first
+void
+thread_pool_destroy(struct thread_pool *pool);
+
+void
+thread_pool_submit(struct thread_pool *pool, struct job_group *group, job_fn_t fn, void *data, int index);
+
+// submits `fn` once for every index in [0, count)
+void
+thread_pool_submit_range(struct thread_pool *pool, struct job_group *group, job_fn_t fn, void *data, int count);
+
+// blocks until all the jobs of the group have finished, running queued jobs (of any group) in the meantime
+void
+thread_pool_wait(struct thread_pool *pool, struct job_group *group);
+
+// how many threads work on jobs, counting the one that waits
+int
+thread_pool_concurrency(struct thread_pool *pool);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef TRIANGULATE_H
+#define TRIANGULATE_H
+
+#include "vec3.h"
+
+// the normal of a polygon by newell's method, which also works for concave polygons and ones that are not quite flat.
+// it points to the side the vertices go around counter clockwise, and is zero when the polygon has no area
+vec3
+polygon_normal(int len, vec3 vertices[len]);
+
+// cuts a simple polygon, convex or concave, into `len - 2` triangles by ear clipping. the polygon is flattened along
+// `normal` first, and the triangles go around the same way as the polygon, as indices into its vertices. a polygon
+// that crosses itself still gets `len - 2` triangles, just not necessarily ones covering exactly its area. returns how
+// many triangles were written
+int
+triangulate_polygon(int len, vec3 vertices[len], vec3 normal, int dest[][3]);
+
+#endif
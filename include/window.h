@@ -5,6 +5,9 @@
 
 #include "state.h"
 
+// the number of buffers in the pool; one on screen, one being drawn into and one finished and waiting to be shown
+#define WINDOW_BUFFER_COUNT 3
+
 struct window {
     struct w_pointer *pointer;
     struct w_keyboard *keyboard;
@@ -15,13 +18,20 @@ struct window {
     struct w_toplevel *toplevel;
 
     struct state *g;
+    struct render_thread *render_thread;
 
     bool mapped;
+    // whether the frame callbacks were stopped because there was nothing new to show, see `window_invalidate()`
+    bool idle;
 };
 
 struct window *
 window_create(struct state *g);
 
+// has the next frame drawn, after anything that shows up in it was changed. only to be called from the event thread
+void
+window_invalidate(struct window *window);
+
 void
 window_destroy(struct window *window);
 
@@ -12,22 +12,43 @@ import os
 
 build_type = BuildType.RELEASE if "--release" in sys.argv else BuildType.DEBUG
 
-ctx = Context.default("main")
-
-ctx.add_include(
-    [
-        "include",
-        "util",
-        "/usr/local/include/w",
-        ctx.build_dir,
-    ]
-)
-
-ctx.add_dependency("wayland-client")
-
-ctx.add_source(["src/" + f for f in os.listdir("src") if f.endswith(".c")])
-
-ctx.add_flag(default_flags(build_type))
-ctx.add_flag("-lw")
-
-ctx.build()
+# these are the only sources that talk to the compositor, everything else in `src/` is the renderer itself and can be
+# linked without wayland
+wayland_sources = ["src/main.c", "src/window.c", "src/render_thread.c"]
+sources = [
+    "src/" + f
+    for f in os.listdir("src")
+    if f.endswith(".c") and "src/" + f not in wayland_sources
+]
+
+
+def target(name, entry, wayland):
+    ctx = Context.default(name)
+
+    ctx.add_include(
+        [
+            "include",
+            "util",
+            "/usr/local/include/w",
+            ctx.build_dir,
+        ]
+    )
+
+    if wayland:
+        ctx.add_dependency("wayland-client")
+
+    ctx.add_source(sources + entry)
+
+    ctx.add_flag(default_flags(build_type))
+    ctx.add_flag("-pthread")
+    if wayland:
+        ctx.add_flag("-lw")
+
+    ctx.build()
+
+
+target("main", wayland_sources, wayland=True)
+# renders into memory instead of a window, see `tools/headless.c`
+target("headless", ["tools/headless.c"], wayland=False)
+# replays camera paths over the predefined scenes and reports frame times, see `tools/bench.c`
+target("bench", ["tools/bench.c"], wayland=False)
@@ -1,20 +1,40 @@
 #include "assets.h"
 
+#include <sys/mman.h>
 #include <sys/stat.h>
 
 #include "alloc.h"
+#include "cache.h"
+#include "impostor.h"
 #include "ints.h"
 #define READER_IMPLEMENTATION
 #include "reader.h"
+#include "macros.h"
+#include "mesh_optimize.h"
+#include "mesh_quantize.h"
+#include "mesh_simplify.h"
+#include "scanner.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+// the smallest piece of an .obj file that is parsed on its own thread
+#ifndef OBJ_CHUNK_SIZE
+#define OBJ_CHUNK_SIZE (1 << 20)
+#endif
+
 struct assets_manager *
 assets_manager_create(void) {
     struct assets_manager *manager = alloc(sizeof(*manager));
     list_init(&manager->meshes);
     // we keep the textures cached here since many materials may use the same reference texture
     list_init(&manager->textures);
+    pthread_mutex_init(&manager->lock, NULL);
+    manager->pool = thread_pool_create(0);
+
+    char *mipmaps = getenv("RASTERIZER_TEXTURE_MIPMAPS");
+    manager->texture_mipmaps = mipmaps && strcmp(mipmaps, "0") != 0;
+    char *quantize = getenv("RASTERIZER_QUANTIZE");
+    manager->quantize_meshes = quantize && strcmp(quantize, "0") != 0;
 
     return manager;
 }
@@ -26,89 +46,132 @@ assets_manager_destroy(struct assets_manager *manager) {
         mesh_destroy(iter);
     }
 
+    mesh_map_deinit(&manager->meshes_by_id);
+    texture_map_deinit(&manager->textures_by_id);
+    thread_pool_destroy(manager->pool);
+    pthread_mutex_destroy(&manager->lock);
     free(manager);
 }
 
+define_array(struct token, token_array);
+
+struct obj_use_material {
+    // relative to the chunk it was found in
+    int face_index;
+    struct token name;
+};
+
+define_array(struct obj_use_material, obj_use_material_array);
+
+static bool
+parse_vec3(struct scanner *line, vec3 *dest) {
+    struct token t;
+    float *dest_coords[] = {&dest->x, &dest->y, &dest->z};
+    for(int i = 0; i < 3; i++) {
+        if(!scanner_next_token(line, &t) || !token_parse_float(&t, dest_coords[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// a piece of an .obj file, parsed on its own and then merged with the others into the mesh. material libraries and
+// `usemtl` statements are only recorded here, since the materials are loaded once all of the chunks are done
+struct obj_chunk {
+    struct scanner scanner;
+
+    vec3_array_t vertices;
+    vec3_array_t normals;
+    vec2_array_t textures;
+    face_array_t faces;
+
+    token_array_t material_libraries;
+    obj_use_material_array_t use_materials;
+
+    bool failed;
+};
+
 static bool
-mesh_add_vertex(struct mesh *mesh, string_array_t *parts) {
-    if(parts->len < 4) {
+chunk_add_vertex(struct obj_chunk *chunk, struct scanner *line) {
+    vec3 this;
+    if(!parse_vec3(line, &this)) {
         return false;
     }
 
-    vec3_array_push(&mesh->vertices,
-            (vec3){
-                    atof(string_c_string_view(&parts->data[1])),
-                    atof(string_c_string_view(&parts->data[2])),
-                    atof(string_c_string_view(&parts->data[3])),
-            });
+    vec3_array_push(&chunk->vertices, this);
 
     return true;
 }
 
 static bool
-mesh_add_normal(struct mesh *mesh, string_array_t *parts) {
-    if(parts->len < 4) {
+chunk_add_normal(struct obj_chunk *chunk, struct scanner *line) {
+    vec3 this;
+    if(!parse_vec3(line, &this)) {
         return false;
     }
 
-    vec3_array_push(&mesh->normals,
-            (vec3){
-                    atof(string_c_string_view(&parts->data[1])),
-                    atof(string_c_string_view(&parts->data[2])),
-                    atof(string_c_string_view(&parts->data[3])),
-            });
+    vec3_array_push(&chunk->normals, this);
 
     return true;
 }
 
 static bool
-mesh_add_texture(struct mesh *mesh, string_array_t *parts) {
-    if(parts->len < 3) {
+chunk_add_texture(struct obj_chunk *chunk, struct scanner *line) {
+    struct token t;
+    vec2 this;
+    if(!scanner_next_token(line, &t) || !token_parse_float(&t, &this.x) || !scanner_next_token(line, &t) ||
+            !token_parse_float(&t, &this.y)) {
         return false;
     }
 
-    vec2 this = {
-            atof(string_c_string_view(&parts->data[1])),
-            atof(string_c_string_view(&parts->data[2])),
-    };
-
     // for some reason some .obj files have vt that wraps so we need to do that
     this.x = this.x - floor(this.x);
     this.y = this.y - floor(this.y);
 
-    vec2_array_push(&mesh->textures, this);
+    vec2_array_push(&chunk->textures, this);
 
     return true;
 }
 
+// parses a single index of a face vertex, where a missing one (e.g. the texture in `1//2`) is -1
 static bool
-parse_face_vertex(string_t *s, struct vertex *dest) {
-    string_array_t parts = {0};
-    string_split(s, '/', false, &parts);
+parse_face_index(struct token *t, int *dest) {
+    int index = 0;
+    if(t->len > 0 && t->data[0] != '/' && !token_parse_int(t, &index)) {
+        return false;
+    }
+
+    *dest = index - 1;
+
+    return true;
+}
+
+// a face vertex is either `v` or `v/vt/vn`, where `vt` may be left out
+static bool
+parse_face_vertex(struct token *t, struct vertex *dest) {
+    if(!parse_face_index(t, &dest->vertex_index)) {
+        return false;
+    }
 
-    bool ret;
-    if(parts.len == 1) {
-        dest->vertex_index = atoi(string_c_string_view(&parts.data[0])) - 1;
+    if(t->len == 0) {
         dest->texture_index = -1;
         dest->normal_index = -1;
 
-        ret = true;
-    } else if(parts.len == 3) {
-        dest->vertex_index = atoi(string_c_string_view(&parts.data[0])) - 1;
-        dest->texture_index = atoi(string_c_string_view(&parts.data[1])) - 1;
-        dest->normal_index = atoi(string_c_string_view(&parts.data[2])) - 1;
+        return true;
+    }
 
-        ret = true;
-    } else {
-        ret = false;
+    if(t->data[0] != '/') {
+        return false;
     }
+    t->data++, t->len--;
 
-    for(struct string *iter = parts.data; iter < string_array_end(&parts); iter++) {
-        string_deinit(iter);
+    if(!parse_face_index(t, &dest->texture_index) || t->len == 0 || t->data[0] != '/') {
+        return false;
     }
-    string_array_deinit(&parts);
+    t->data++, t->len--;
 
-    return ret;
+    return parse_face_index(t, &dest->normal_index) && t->len == 0;
 }
 
 static bool
@@ -117,15 +180,15 @@ is_valid_vertex(struct mesh *mesh, struct vertex *vertex) {
             vertex->normal_index < mesh->normals.len && vertex->texture_index < mesh->textures.len;
 }
 
+// note: the indices are global for the whole file, so they can only be checked once all the chunks are merged
 static bool
-mesh_add_face(struct mesh *mesh, string_array_t *parts) {
-    if(parts->len < 4) {
-        return false;
-    }
-
+chunk_add_face(struct obj_chunk *chunk, struct scanner *line) {
     struct vertex first = {-1, -1, -1}, last = {-1, -1, -1}, cur;
-    for(int i = 1; i < parts->len; i++) {
-        if(!parse_face_vertex(&parts->data[i], &cur) || !is_valid_vertex(mesh, &cur)) {
+    int count = 0;
+
+    struct token t;
+    while(scanner_next_token(line, &t)) {
+        if(!parse_face_vertex(&t, &cur) || cur.vertex_index < 0) {
             return false;
         }
 
@@ -134,56 +197,131 @@ mesh_add_face(struct mesh *mesh, string_array_t *parts) {
         } else if(last.vertex_index == -1) {
             last = cur;
         } else {
-            face_array_push(&mesh->faces, (struct face){first, last, cur});
+            face_array_push(&chunk->faces, (struct face){first, last, cur});
             last = cur;
         }
+        count++;
     }
 
-    return true;
+    return count >= 3;
 }
 
-static bool
-are_same_file(string_t *p1, string_t *p2) {
-    struct stat s1, s2;
-    if(stat(string_c_string_view(p1), &s1) != 0) {
-        return false;
+static void
+chunk_add_material_libraries(struct obj_chunk *chunk, struct scanner *line) {
+    struct token t;
+    while(scanner_next_token(line, &t)) {
+        token_array_push(&chunk->material_libraries, t);
     }
+}
 
-    if(stat(string_c_string_view(p2), &s2) != 0) {
-        return false;
+static void
+chunk_add_use_material(struct obj_chunk *chunk, struct scanner *line) {
+    struct token name;
+    if(!scanner_next_token(line, &name)) {
+        // not fatal
+        return;
     }
 
-    return s1.st_ino == s2.st_ino && s1.st_dev == s2.st_dev;
+    obj_use_material_array_push(&chunk->use_materials,
+            (struct obj_use_material){
+                    .face_index = chunk->faces.len,
+                    .name = name,
+            });
 }
 
-static struct texture *
-try_find_texture(struct assets_manager *manager, string_t *path) {
-    list_for_each(struct texture, iter, &manager->textures, link) {
-        if(are_same_file(path, &iter->path)) {
-            return iter;
+static void
+chunk_parse(void *data, int index) {
+    struct obj_chunk *chunk = &((struct obj_chunk *)data)[index];
+
+    struct scanner line;
+    while(scanner_next_line(&chunk->scanner, &line)) {
+        struct token key;
+        if(!scanner_next_token(&line, &key)) {
+            continue;
         }
+
+        bool ok = true;
+        if(token_equal_c_string(&key, "v")) {
+            ok = chunk_add_vertex(chunk, &line);
+        } else if(token_equal_c_string(&key, "vn")) {
+            ok = chunk_add_normal(chunk, &line);
+        } else if(token_equal_c_string(&key, "vt")) {
+            ok = chunk_add_texture(chunk, &line);
+        } else if(token_equal_c_string(&key, "f")) {
+            ok = chunk_add_face(chunk, &line);
+        } else if(token_equal_c_string(&key, "mtllib")) {
+            // this is not critical, so we dont fail immediately
+            chunk_add_material_libraries(chunk, &line);
+        } else if(token_equal_c_string(&key, "usemtl")) {
+            // same
+            chunk_add_use_material(chunk, &line);
+        }
+
+        if(!ok) {
+            chunk->failed = true;
+            return;
+        }
+    }
+}
+
+static void
+chunk_deinit(struct obj_chunk *chunk) {
+    vec3_array_deinit(&chunk->vertices);
+    vec3_array_deinit(&chunk->normals);
+    vec2_array_deinit(&chunk->textures);
+    face_array_deinit(&chunk->faces);
+    token_array_deinit(&chunk->material_libraries);
+    obj_use_material_array_deinit(&chunk->use_materials);
+}
+
+bool
+file_id_get(char *path, struct file_id *dest) {
+    struct stat st;
+    if(stat(path, &st) != 0) {
+        return false;
     }
 
-    return NULL;
+    *dest = (struct file_id){st.st_dev, st.st_ino};
+
+    return true;
 }
 
 static void
-texture_ref(struct texture *texture) {
-    texture->ref_count++;
+texture_destroy(struct texture *texture) {
+    string_deinit(&texture->path);
+
+    if(texture->cache) {
+        munmap(texture->cache, texture->cache_len);
+    } else {
+        for(int i = 0; i < texture->levels_len; i++) {
+            free(texture->levels[i].pixels);
+        }
+    }
+
+    free(texture);
 }
 
 static void
 texture_unref(struct texture *texture) {
-    texture->ref_count--;
-    if(texture->ref_count == 0) {
+    struct assets_manager *manager = texture->manager;
+
+    pthread_mutex_lock(&manager->lock);
+    bool last = --texture->ref_count == 0;
+    if(last) {
         list_remove(&texture->link);
-        string_deinit(&texture->path);
-        free(texture->pixels);
-        free(texture);
+        texture_map_remove(&manager->textures_by_id, &texture->id);
+    }
+    pthread_mutex_unlock(&manager->lock);
+
+    if(last) {
+        // the job loading it may still be queued or running, and the pool touches `loading` once the job returns, so
+        // that has to be over before the texture can go. nobody else can find it anymore, so nothing new gets queued
+        thread_pool_wait(manager->pool, &texture->loading);
+        texture_destroy(texture);
     }
 }
 
-static void
+void
 material_destroy(struct material *material) {
     string_deinit(&material->name);
 
@@ -218,23 +356,124 @@ create_path_from_current_context(string_t *current, string_t *path) {
     path->len += last_slash + 1;
 }
 
-static struct texture *
-texture_load(string_t *path) {
-    int width, height, channels;
-    u8 *pixels = stbi_load(string_c_string_view(path), &width, &height, &channels, 4);
-    if(!pixels) {
+// averages every 2x2 block of the previous level
+static void
+texture_add_level(struct texture *texture) {
+    struct texture_level *prev = &texture->levels[texture->levels_len - 1];
+    struct texture_level *level = &texture->levels[texture->levels_len++];
+
+    level->width = max(prev->width / 2, 1);
+    level->height = max(prev->height / 2, 1);
+    level->pixels = alloc(level->width * level->height * 4);
+
+    for(int y = 0; y < level->height; y++) {
+        // for odd sizes the last row and column are dropped, and a 1 wide level just repeats its only column
+        int y0 = min(2 * y, prev->height - 1), y1 = min(2 * y + 1, prev->height - 1);
+        for(int x = 0; x < level->width; x++) {
+            int x0 = min(2 * x, prev->width - 1), x1 = min(2 * x + 1, prev->width - 1);
+
+            u8 *p00 = &prev->pixels[(y0 * prev->width + x0) * 4];
+            u8 *p01 = &prev->pixels[(y0 * prev->width + x1) * 4];
+            u8 *p10 = &prev->pixels[(y1 * prev->width + x0) * 4];
+            u8 *p11 = &prev->pixels[(y1 * prev->width + x1) * 4];
+            u8 *dest = &level->pixels[(y * level->width + x) * 4];
+            for(int i = 0; i < 4; i++) {
+                dest[i] = (p00[i] + p01[i] + p10[i] + p11[i] + 2) / 4;
+            }
+        }
+    }
+}
+
+// fills in the levels of the texture, leaving it without any if the image could not be loaded
+static void
+texture_load(struct texture *texture, bool mipmaps) {
+    // decoding is by far the slowest part, so try the cache first
+    if(!texture_cache_load(texture, mipmaps)) {
+        int width, height, channels;
+        u8 *pixels = stbi_load(texture->path.data, &width, &height, &channels, 4);
+        if(!pixels) {
+            return;
+        }
+
+        texture->levels[0] = (struct texture_level){width, height, pixels};
+        texture->levels_len = 1;
+        while(mipmaps && texture->levels_len < TEXTURE_MAX_LEVELS &&
+                (texture_last_level(texture)->width > 1 || texture_last_level(texture)->height > 1)) {
+            texture_add_level(texture);
+        }
+
+        // not being able to write it is not a problem, we just decode it again next time
+        texture_cache_store(texture);
+    }
+
+    texture->width = texture->levels[0].width;
+    texture->height = texture->levels[0].height;
+    texture->pixels = texture->levels[0].pixels;
+}
+
+static void
+texture_load_job(void *data, int index) {
+    unused(index);
+    struct texture *texture = data;
+
+    // the job holds no reference of its own, dropping the last one waits for it instead, see `texture_unref()`
+    texture_load(texture, texture->manager->texture_mipmaps);
+}
+
+struct texture *
+assets_manager_get_texture(struct assets_manager *manager, string_t *path) {
+    struct file_id id;
+    if(!file_id_get(string_c_string_view(path), &id)) {
         return NULL;
     }
 
+    pthread_mutex_lock(&manager->lock);
+
+    struct texture **found = texture_map_get(&manager->textures_by_id, &id);
+    if(found) {
+        struct texture *texture = *found;
+        texture->ref_count++;
+        pthread_mutex_unlock(&manager->lock);
+        return texture;
+    }
+
+    // put it in the list right away, so anyone asking for it while it is still loading waits for this one instead of
+    // loading it again
     struct texture *texture = alloc(sizeof(*texture));
     string_clone(&texture->path, path);
-    texture->width = width;
-    texture->height = height;
-    texture->pixels = pixels;
+    texture->id = id;
+    // note: this is shared between threads from now on, and `string_c_string_view()` writes to the string every time,
+    // so it is terminated once here and only ever read through `data` after this
+    string_c_string_view(&texture->path);
+    texture->manager = manager;
+    texture->ref_count = 1;
+    list_insert(&manager->textures, &texture->link);
+    texture_map_put(&manager->textures_by_id, id, texture);
+
+    thread_pool_submit(manager->pool, &texture->loading, texture_load_job, texture, 0);
+    pthread_mutex_unlock(&manager->lock);
 
     return texture;
 }
 
+bool
+assets_manager_wait_texture(struct assets_manager *manager, struct texture *texture) {
+    thread_pool_wait(manager->pool, &texture->loading);
+
+    return texture->levels_len > 0;
+}
+
+// waits for the textures of all the materials and drops the ones that failed to load
+static void
+mesh_wait_textures(struct assets_manager *manager, struct mesh *mesh) {
+    list_for_each(struct material, iter, &mesh->materials, link) {
+        if(iter->texture && !assets_manager_wait_texture(manager, iter->texture)) {
+            texture_unref(iter->texture);
+            iter->texture = NULL;
+        }
+    }
+}
+
 static void
 material_add_texture(struct assets_manager *manager, string_t *current_path, struct material *material,
         string_array_t *parts) {
@@ -245,22 +484,7 @@ material_add_texture(struct assets_manager *manager, string_t *current_path, str
     string_t *path = &parts->data[1];
     create_path_from_current_context(current_path, path);
 
-    struct texture *texture = try_find_texture(manager, path);
-    if(texture) {
-        material->texture = texture;
-        texture_ref(texture);
-        return;
-    }
-
-    // load the texture and cache it
-    texture = texture_load(path);
-    if(!texture) {
-        return;
-    }
-
-    material->texture = texture;
-    texture_ref(texture);
-    list_insert(&manager->textures, &texture->link);
+    material->texture = assets_manager_get_texture(manager, path);
 }
 
 static void
@@ -270,6 +494,10 @@ mesh_load_materials(struct assets_manager *manager, struct mesh *mesh, string_t
         return;
     }
 
+    string_t library = {0};
+    string_clone(&library, path);
+    string_array_push(&mesh->material_libraries, library);
+
     struct material *material = NULL;
 
     string_t line = {0};
@@ -285,7 +513,7 @@ mesh_load_materials(struct assets_manager *manager, struct mesh *mesh, string_t
 
             if(material) {
                 // finish with the current one
-                list_insert(&mesh->materials, &material->link);
+                mesh_add_material(mesh, material);
             }
 
             // and create a new one with this name
@@ -368,7 +596,7 @@ mesh_load_materials(struct assets_manager *manager, struct mesh *mesh, string_t
 
     if(material) {
         // insert the last one
-        list_insert(&mesh->materials, &material->link);
+        mesh_add_material(mesh, material);
     }
 
     string_array_deinit(&parts);
@@ -391,134 +619,367 @@ err:
 }
 
 static void
-mesh_add_material_library(struct assets_manager *manager, struct mesh *mesh, string_array_t *parts) {
-    if(parts->len < 2) {
+mesh_add_material_library(struct assets_manager *manager, struct mesh *mesh, struct token *name) {
+    string_t path = {0};
+    string_reserve(&path, name->len + 1);
+    memcpy(path.data, name->data, name->len);
+    path.len = name->len;
+
+    create_path_from_current_context(&mesh->path, &path);
+    mesh_load_materials(manager, mesh, &path);
+    string_deinit(&path);
+}
+
+void
+mesh_add_material(struct mesh *mesh, struct material *material) {
+    list_insert(&mesh->materials, &material->link);
+    material_map_put(&mesh->materials_by_name, material->name, material);
+}
+
+static void
+mesh_add_use_material(struct mesh *mesh, struct token *name, int face_index) {
+    string_t key = {.len = name->len, .data = name->data};
+    struct material **material = material_map_get(&mesh->materials_by_name, &key);
+    if(!material) {
         return;
     }
 
-    for(int i = 1; i < parts->len; i++) {
-        string_t *path = &parts->data[1];
-        create_path_from_current_context(&mesh->path, path);
-        mesh_load_materials(manager, mesh, path);
+    use_material_array_push(&mesh->use_materials,
+            (struct use_material){
+                    .face_index = face_index,
+                    .material = *material,
+            });
+}
+
+// maps the whole file into memory, so it can be parsed in place
+static char *
+map_file(char *path, size_t *len) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    close(fd);
+    if(data == MAP_FAILED) {
+        return NULL;
     }
+
+    // we go through it front to back exactly once
+    madvise(data, st.st_size, MADV_SEQUENTIAL | MADV_WILLNEED);
+
+    *len = st.st_size;
+    return data;
 }
 
-static struct material *
-try_find_material(struct mesh *mesh, string_t *name) {
-    list_for_each(struct material, iter, &mesh->materials, link) {
-        if(string_equal(&iter->name, name)) {
-            return iter;
+// splits the file into about `count` chunks that each start at the beginning of a line
+static int
+split_into_chunks(char *data, size_t len, int count, struct obj_chunk *dest) {
+    char *start = data, *end = data + len;
+
+    int i = 0;
+    for(; i < count && start < end; i++) {
+        char *chunk_end = i == count - 1 ? end : start + len / count;
+        if(chunk_end >= end) {
+            chunk_end = end;
+        } else {
+            char *newline = memchr(chunk_end, '\n', end - chunk_end);
+            chunk_end = newline ? newline + 1 : end;
         }
+
+        memset(&dest[i], 0, sizeof(dest[i]));
+        scanner_init(&dest[i].scanner, start, chunk_end - start);
+        start = chunk_end;
     }
 
-    return NULL;
+    return i;
 }
 
+// the offsets of a chunk's arrays in the merged mesh
+struct chunk_offsets {
+    int vertices, normals, textures, faces;
+};
+
+struct merge_context {
+    struct mesh *mesh;
+    struct obj_chunk *chunks;
+    struct chunk_offsets *offsets;
+};
+
+// copies the parsed data of a chunk to its place in the mesh. the indices in the faces are already global, but they
+// could not be checked before the total counts were known
 static void
-mesh_add_use_material(struct mesh *mesh, string_array_t *parts) {
-    if(parts->len < 2) {
-        // not fatal
-        return;
+chunk_merge(void *data, int index) {
+    struct merge_context *ctx = data;
+    struct obj_chunk *chunk = &ctx->chunks[index];
+    struct chunk_offsets *offsets = &ctx->offsets[index];
+    struct mesh *mesh = ctx->mesh;
+
+    memcpy(&mesh->vertices.data[offsets->vertices], chunk->vertices.data, chunk->vertices.len * sizeof(vec3));
+    memcpy(&mesh->normals.data[offsets->normals], chunk->normals.data, chunk->normals.len * sizeof(vec3));
+    memcpy(&mesh->textures.data[offsets->textures], chunk->textures.data, chunk->textures.len * sizeof(vec2));
+    memcpy(&mesh->faces.data[offsets->faces], chunk->faces.data, chunk->faces.len * sizeof(struct face));
+
+    for(struct face *face = chunk->faces.data; face < face_array_end(&chunk->faces); face++) {
+        for(int i = 0; i < 3; i++) {
+            if(!is_valid_vertex(mesh, &face->vertices[i])) {
+                chunk->failed = true;
+                return;
+            }
+        }
     }
+}
 
-    string_t *name = &parts->data[1];
-    struct material *material = try_find_material(mesh, name);
-    if(!material) {
+void
+mesh_compute_bounds(struct mesh *mesh) {
+    if(mesh->vertices.len == 0) {
         return;
     }
 
-    int face_index = mesh->faces.len;
-    use_material_array_push(&mesh->use_materials,
-            (struct use_material){
-                    .face_index = face_index,
-                    .material = material,
-            });
+    vec3 low = mesh->vertices.data[0], high = low;
+    for(vec3 *v = mesh->vertices.data; v < vec3_array_end(&mesh->vertices); v++) {
+        low = (vec3){min(low.x, v->x), min(low.y, v->y), min(low.z, v->z)};
+        high = (vec3){max(high.x, v->x), max(high.y, v->y), max(high.z, v->z)};
+    }
+    mesh->center = vec3_scale(0.5f, vec3_add(low, high));
+
+    float radius = 0.0f;
+    for(vec3 *v = mesh->vertices.data; v < vec3_array_end(&mesh->vertices); v++) {
+        radius = max(radius, vec3_len(vec3_sub(*v, mesh->center)));
+    }
+    mesh->radius = radius;
 }
 
-struct mesh *
-assets_manager_load_mesh(struct assets_manager *manager, char *path) {
-    struct reader *r = reader_create(path);
-    if(!r) {
+static struct mesh *
+mesh_load(struct assets_manager *manager, char *path) {
+    struct file_id id;
+    if(!file_id_get(path, &id)) {
         return NULL;
     }
 
-    struct mesh *mesh = alloc(sizeof(*mesh));
+    pthread_mutex_lock(&manager->lock);
+    // the entries of the map move whenever another load adds to it, so the mesh is taken out while still locked
+    struct mesh **found = mesh_map_get(&manager->meshes_by_id, &id);
+    struct mesh *existing = found ? *found : NULL;
+    pthread_mutex_unlock(&manager->lock);
+    if(existing) {
+        return existing;
+    }
+
+    struct mesh *mesh = mesh_cache_load(manager, path, manager->quantize_meshes);
+    if(mesh) {
+        mesh_wait_textures(manager, mesh);
+        goto done;
+    }
+
+    size_t len;
+    char *data = map_file(path, &len);
+    if(!data) {
+        return NULL;
+    }
+
+    mesh = alloc(sizeof(*mesh));
     string_init(&mesh->path, path);
     list_init(&mesh->materials);
 
-    string_t line = {0};
-    string_array_t parts = {0};
-    while(reader_read_line(r, &line)) {
-        string_split(&line, ' ', true, &parts);
-
-        string_t *key = &parts.data[0];
-        if(string_equal_c_string(key, "v")) {
-            if(!mesh_add_vertex(mesh, &parts)) {
-                goto err;
-            }
-        } else if(string_equal_c_string(key, "vn")) {
-            if(!mesh_add_normal(mesh, &parts)) {
-                goto err;
-            }
-        } else if(string_equal_c_string(key, "vt")) {
-            if(!mesh_add_texture(mesh, &parts)) {
-                goto err;
-            }
-        } else if(string_equal_c_string(key, "f")) {
-            if(!mesh_add_face(mesh, &parts)) {
-                goto err;
-            }
-        } else if(string_equal_c_string(key, "mtllib")) {
-            // this is not critical, so we dont fail immediately
-            mesh_add_material_library(manager, mesh, &parts);
-        } else if(string_equal_c_string(key, "usemtl")) {
-            // same
-            mesh_add_use_material(mesh, &parts);
+    // small files are not worth the trouble of splitting
+    int count = min((int)(len / OBJ_CHUNK_SIZE), 4 * thread_pool_concurrency(manager->pool));
+    count = max(count, 1);
+
+    struct obj_chunk *chunks = alloc(count * sizeof(*chunks));
+    count = split_into_chunks(data, len, count, chunks);
+
+    struct job_group group = {0};
+    thread_pool_submit_range(manager->pool, &group, chunk_parse, chunks, count);
+    thread_pool_wait(manager->pool, &group);
+
+    struct chunk_offsets *offsets = alloc(count * sizeof(*offsets));
+    struct chunk_offsets total = {0};
+    bool failed = false;
+    for(int i = 0; i < count; i++) {
+        failed |= chunks[i].failed;
+
+        offsets[i] = total;
+        total.vertices += chunks[i].vertices.len;
+        total.normals += chunks[i].normals.len;
+        total.textures += chunks[i].textures.len;
+        total.faces += chunks[i].faces.len;
+    }
+    if(failed) {
+        goto err;
+    }
+
+    vec3_array_reserve(&mesh->vertices, total.vertices);
+    mesh->vertices.len = total.vertices;
+    vec3_array_reserve(&mesh->normals, total.normals);
+    mesh->normals.len = total.normals;
+    vec2_array_reserve(&mesh->textures, total.textures);
+    mesh->textures.len = total.textures;
+    face_array_reserve(&mesh->faces, total.faces);
+    mesh->faces.len = total.faces;
+
+    struct merge_context ctx = {mesh, chunks, offsets};
+    thread_pool_submit_range(manager->pool, &group, chunk_merge, &ctx, count);
+    thread_pool_wait(manager->pool, &group);
+
+    for(int i = 0; i < count; i++) {
+        if(chunks[i].failed) {
+            goto err;
         }
+    }
 
-        // finish by releasing resources for this line
-        for(struct string *iter = parts.data; iter < string_array_end(&parts); iter++) {
-            string_deinit(iter);
+    // the materials have to be known before they can be used, so these go last and in file order
+    for(int i = 0; i < count; i++) {
+        for(struct token *name = chunks[i].material_libraries.data;
+                name < token_array_end(&chunks[i].material_libraries); name++) {
+            mesh_add_material_library(manager, mesh, name);
+        }
+    }
+    for(int i = 0; i < count; i++) {
+        for(struct obj_use_material *use = chunks[i].use_materials.data;
+                use < obj_use_material_array_end(&chunks[i].use_materials); use++) {
+            mesh_add_use_material(mesh, &use->name, offsets[i].faces + use->face_index);
         }
     }
 
-    string_array_deinit(&parts);
-    string_deinit(&line);
-    reader_destroy(r);
+    for(int i = 0; i < count; i++) {
+        chunk_deinit(&chunks[i]);
+    }
+    free(chunks);
+    free(offsets);
+    munmap(data, len);
+
+    mesh_optimize(mesh);
+    mesh_build_lods(mesh);
+    // the cache keeps the bounds, so they are only computed here
+    mesh_compute_bounds(mesh);
+    if(manager->quantize_meshes) {
+        mesh_quantize(mesh);
+    }
+
+    // the textures were loading in the background the whole time the rest was being parsed
+    mesh_wait_textures(manager, mesh);
+
+    // failing to write the cache only means we parse it again next time
+    mesh_cache_store(mesh);
+
+done:
+    pthread_mutex_lock(&manager->lock);
+    found = mesh_map_get(&manager->meshes_by_id, &id);
+    if(found) {
+        // someone else loaded the same file at the same time, so keep theirs
+        existing = *found;
+        pthread_mutex_unlock(&manager->lock);
+        mesh_destroy(mesh);
+        return existing;
+    }
 
     // insert it into a list, so we can more easily track it; this way we can just destoy the manager instead of
     // tracking all of the meshes independently
     list_insert(manager->meshes.prev, &mesh->link);
+    mesh_map_put(&manager->meshes_by_id, id, mesh);
+    pthread_mutex_unlock(&manager->lock);
 
     return mesh;
 
 err:
-    for(struct string *iter = parts.data; iter < string_array_end(&parts); iter++) {
-        string_deinit(iter);
+    for(int i = 0; i < count; i++) {
+        chunk_deinit(&chunks[i]);
     }
-
-    string_array_deinit(&parts);
-    string_deinit(&line);
-    reader_destroy(r);
+    free(chunks);
+    free(offsets);
+    munmap(data, len);
     mesh_destroy(mesh);
 
     return NULL;
 }
 
+struct mesh *
+assets_manager_load_mesh(struct assets_manager *manager, char *path) {
+    return mesh_load(manager, path);
+}
+
+struct mesh_future {
+    struct assets_manager *manager;
+    struct job_group group;
+
+    char *path;
+    // only valid once the group is done
+    struct mesh *mesh;
+};
+
+static void
+mesh_load_job(void *data, int index) {
+    unused(index);
+    struct mesh_future *future = data;
+
+    future->mesh = mesh_load(future->manager, future->path);
+}
+
+struct mesh_future *
+assets_manager_load_mesh_async(struct assets_manager *manager, char *path) {
+    struct mesh_future *future = alloc(sizeof(*future));
+    future->manager = manager;
+    future->path = strdup(path);
+
+    thread_pool_submit(manager->pool, &future->group, mesh_load_job, future, 0);
+
+    return future;
+}
+
+struct mesh *
+mesh_future_wait(struct mesh_future *future) {
+    thread_pool_wait(future->manager->pool, &future->group);
+
+    struct mesh *mesh = future->mesh;
+    free(future->path);
+    free(future);
+
+    return mesh;
+}
+
 void
 mesh_destroy(struct mesh *mesh) {
     string_deinit(&mesh->path);
+    for(struct string *iter = mesh->material_libraries.data; iter < string_array_end(&mesh->material_libraries);
+            iter++) {
+        string_deinit(iter);
+    }
+    string_array_deinit(&mesh->material_libraries);
 
     vec3_array_deinit(&mesh->vertices);
     vec3_array_deinit(&mesh->normals);
     vec2_array_deinit(&mesh->textures);
+    u16vec3_array_deinit(&mesh->packed_vertices);
+    i16vec2_array_deinit(&mesh->packed_normals);
+    u16vec2_array_deinit(&mesh->packed_textures);
     face_array_deinit(&mesh->faces);
 
     use_material_array_deinit(&mesh->use_materials);
+    for(int i = 0; i < mesh->lods_len; i++) {
+        face_array_deinit(&mesh->lods[i].faces);
+        use_material_array_deinit(&mesh->lods[i].use_materials);
+    }
 
     list_for_each_safe(struct material, iter, &mesh->materials, link) {
         material_destroy(iter);
     }
+    material_map_deinit(&mesh->materials_by_name);
+
+    if(mesh->impostor) {
+        impostor_destroy(mesh->impostor);
+    }
+
+    if(mesh->cache) {
+        munmap(mesh->cache, mesh->cache_len);
+    }
 
     // this is a bit hacky but works since the only way to have this as NULL is if its called one error in
     // `assets_manager_load_mesh()`. note that that may change so corections might be needed in the future
@@ -0,0 +1,681 @@
+#include "cache.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "alloc.h"
+#include "ints.h"
+#include "macros.h"
+
+// everything in the file is aligned to this, so the arrays can be used right where they are mapped
+#define CACHE_ALIGNMENT 16
+
+static char mesh_magic[4] = {'R', 'M', 'S', 'H'};
+static char texture_magic[4] = {'R', 'T', 'E', 'X'};
+
+// the state of a file when the cache was written
+struct cache_dependency {
+    u64 size;
+    i64 mtime;
+    u32 path_len;
+    u32 padding;
+    // followed by the path
+};
+
+struct mesh_cache_header {
+    char magic[4];
+    u32 version;
+
+    // the .obj file itself
+    u64 source_size;
+    i64 source_mtime;
+
+    u32 dependencies_len;
+    u32 materials_len;
+    u32 use_materials_len;
+    i32 vertices_len, normals_len, textures_len, faces_len;
+    u32 lods_len;
+
+    // whether the vertices, normals and texture coordinates are stored packed, see `mesh_quantize()`
+    u32 quantized;
+    vec3 vertices_min, vertices_scale;
+    vec2 textures_min, textures_scale;
+
+    vec3 center;
+    float radius;
+    u32 padding;
+
+    // followed by the dependencies, materials, use materials, all the arrays and then the lods
+};
+
+struct mesh_cache_material {
+    vec3 diffuse_color;
+    vec3 specular_color;
+    vec3 ambient_color;
+    float shininess;
+    float opacity;
+    i32 illumination_model;
+
+    u32 name_len;
+    // 0 if it has no texture
+    u32 texture_len;
+    // followed by the name and then the texture path
+};
+
+struct mesh_cache_use_material {
+    i32 face_index;
+    // in the order the materials are stored in
+    i32 material;
+};
+
+// followed by its use materials and faces
+struct mesh_cache_lod {
+    i32 faces_len, use_materials_len;
+    i32 vertices_len, normals_len;
+    float error;
+    u32 padding[3];
+};
+
+struct texture_cache_header {
+    char magic[4];
+    u32 version;
+
+    // the identity of the image file, so a different file at the same path is not mistaken for it
+    u64 source_dev;
+    u64 source_ino;
+    u64 source_size;
+    i64 source_mtime;
+
+    u32 levels_len;
+    u32 padding;
+    struct {
+        i32 width, height;
+    } levels[TEXTURE_MAX_LEVELS];
+
+    // followed by the rgba pixels of each level
+};
+
+bool
+cache_path(char *source, char *extension, string_t *dest) {
+    char *dir = getenv("RASTERIZER_CACHE_DIR");
+    if(dir && dir[0] == '\0') {
+        return false;
+    }
+
+    dest->len = 0;
+    if(dir) {
+        string_append_c_string(dest, dir);
+        string_append(dest, '/');
+
+        // flatten the path, so every source gets its own file in the directory
+        for(char *c = source; *c; c++) {
+            string_append(dest, *c == '/' ? '%' : *c);
+        }
+    } else {
+        string_append_c_string(dest, source);
+    }
+
+    string_append(dest, '.');
+    string_append_c_string(dest, extension);
+
+    return true;
+}
+
+static i64
+stat_mtime(struct stat *st) {
+    return (i64)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+static bool
+stat_file(char *path, u64 *size, i64 *mtime) {
+    struct stat st;
+    if(stat(path, &st) != 0) {
+        return false;
+    }
+
+    *size = st.st_size;
+    *mtime = stat_mtime(&st);
+
+    return true;
+}
+
+static bool
+write_padded(FILE *f, void *data, size_t len) {
+    static char zeros[CACHE_ALIGNMENT] = {0};
+    size_t padding = (CACHE_ALIGNMENT - len % CACHE_ALIGNMENT) % CACHE_ALIGNMENT;
+
+    return fwrite(data, 1, len, f) == len && fwrite(zeros, 1, padding, f) == padding;
+}
+
+static bool
+write_dependency(FILE *f, char *path) {
+    struct cache_dependency dependency = {0};
+    if(!stat_file(path, &dependency.size, &dependency.mtime)) {
+        return false;
+    }
+    dependency.path_len = strlen(path);
+
+    return write_padded(f, &dependency, sizeof(dependency)) && write_padded(f, path, dependency.path_len);
+}
+
+static bool
+write_material(FILE *f, struct material *material) {
+    struct mesh_cache_material this = {
+            .diffuse_color = material->diffuse_color,
+            .specular_color = material->specular_color,
+            .ambient_color = material->ambient_color,
+            .shininess = material->shininess,
+            .opacity = material->opacity,
+            .illumination_model = material->illumination_model,
+            .name_len = material->name.len,
+            .texture_len = material->texture ? material->texture->path.len : 0,
+    };
+
+    return write_padded(f, &this, sizeof(this)) && write_padded(f, material->name.data, this.name_len) &&
+            (!material->texture || write_padded(f, material->texture->path.data, this.texture_len));
+}
+
+static int
+material_index(struct mesh *mesh, struct material *material) {
+    int i = 0;
+    list_for_each(struct material, iter, &mesh->materials, link) {
+        if(iter == material) {
+            return i;
+        }
+        i++;
+    }
+
+    return -1;
+}
+
+static bool
+write_use_materials(FILE *f, struct mesh *mesh, use_material_array_t *use_materials) {
+    struct mesh_cache_use_material *uses = alloc((use_materials->len + 1) * sizeof(*uses));
+    for(int i = 0; i < use_materials->len; i++) {
+        struct use_material *use = &use_materials->data[i];
+        uses[i] = (struct mesh_cache_use_material){use->face_index, material_index(mesh, use->material)};
+    }
+
+    bool ok = write_padded(f, uses, use_materials->len * sizeof(*uses));
+    free(uses);
+
+    return ok;
+}
+
+// quantized meshes are kept apart, so switching between them does not throw the other one away
+static char *
+mesh_cache_extension(bool quantized) {
+    return quantized ? "quant.mesh" : "mesh";
+}
+
+bool
+mesh_cache_store(struct mesh *mesh) {
+    string_t path = {0}, tmp = {0};
+    if(!cache_path(string_c_string_view(&mesh->path), mesh_cache_extension(mesh->quantized), &path)) {
+        return false;
+    }
+
+    struct mesh_cache_header header = {
+            .version = CACHE_VERSION,
+            .dependencies_len = mesh->material_libraries.len,
+            .materials_len = list_length(&mesh->materials),
+            .use_materials_len = mesh->use_materials.len,
+            .vertices_len = mesh_vertices_len(mesh),
+            .normals_len = mesh_normals_len(mesh),
+            .textures_len = mesh_textures_len(mesh),
+            .faces_len = mesh->faces.len,
+            .lods_len = mesh->lods_len,
+            .quantized = mesh->quantized,
+            .vertices_min = mesh->vertices_min,
+            .vertices_scale = mesh->vertices_scale,
+            .textures_min = mesh->textures_min,
+            .textures_scale = mesh->textures_scale,
+            .center = mesh->center,
+            .radius = mesh->radius,
+    };
+    memcpy(header.magic, mesh_magic, sizeof(mesh_magic));
+
+    bool ret = false;
+    if(!stat_file(string_c_string_view(&mesh->path), &header.source_size, &header.source_mtime)) {
+        goto out;
+    }
+
+    // written under a temporary name and then renamed, so nobody ever maps a half written file
+    string_clone(&tmp, &path);
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%d.tmp", (int)getpid());
+    string_append_c_string(&tmp, suffix);
+
+    FILE *f = fopen(string_c_string_view(&tmp), "wb");
+    if(!f) {
+        goto out;
+    }
+
+    bool ok = write_padded(f, &header, sizeof(header));
+    for(int i = 0; ok && i < mesh->material_libraries.len; i++) {
+        ok = write_dependency(f, string_c_string_view(&mesh->material_libraries.data[i]));
+    }
+
+    list_for_each(struct material, iter, &mesh->materials, link) {
+        ok = ok && write_material(f, iter);
+    }
+
+    ok = ok && write_use_materials(f, mesh, &mesh->use_materials);
+
+    if(mesh->quantized) {
+        ok = ok && write_padded(f, mesh->packed_vertices.data, mesh->packed_vertices.len * sizeof(u16vec3));
+        ok = ok && write_padded(f, mesh->packed_normals.data, mesh->packed_normals.len * sizeof(i16vec2));
+        ok = ok && write_padded(f, mesh->packed_textures.data, mesh->packed_textures.len * sizeof(u16vec2));
+    } else {
+        ok = ok && write_padded(f, mesh->vertices.data, mesh->vertices.len * sizeof(vec3));
+        ok = ok && write_padded(f, mesh->normals.data, mesh->normals.len * sizeof(vec3));
+        ok = ok && write_padded(f, mesh->textures.data, mesh->textures.len * sizeof(vec2));
+    }
+    ok = ok && write_padded(f, mesh->faces.data, mesh->faces.len * sizeof(struct face));
+
+    for(int i = 0; ok && i < mesh->lods_len; i++) {
+        struct mesh_lod *lod = &mesh->lods[i];
+        struct mesh_cache_lod this = {
+                .faces_len = lod->faces.len,
+                .use_materials_len = lod->use_materials.len,
+                .vertices_len = lod->vertices_len,
+                .normals_len = lod->normals_len,
+                .error = lod->error,
+        };
+
+        ok = write_padded(f, &this, sizeof(this)) && write_use_materials(f, mesh, &lod->use_materials) &&
+                write_padded(f, lod->faces.data, lod->faces.len * sizeof(struct face));
+    }
+
+    ok = fclose(f) == 0 && ok;
+    if(ok && rename(string_c_string_view(&tmp), string_c_string_view(&path)) == 0) {
+        ret = true;
+    } else {
+        unlink(string_c_string_view(&tmp));
+    }
+
+out:
+    string_deinit(&tmp);
+    string_deinit(&path);
+
+    return ret;
+}
+
+// reads through a mapped cache file, checking that nothing goes past its end
+struct cache_cursor {
+    char *cur, *end;
+};
+
+static void *
+cursor_take(struct cache_cursor *cursor, size_t len) {
+    size_t padded = (len + CACHE_ALIGNMENT - 1) / CACHE_ALIGNMENT * CACHE_ALIGNMENT;
+    if((size_t)(cursor->end - cursor->cur) < padded) {
+        return NULL;
+    }
+
+    void *data = cursor->cur;
+    cursor->cur += padded;
+
+    return data;
+}
+
+static bool
+cursor_take_string(struct cache_cursor *cursor, u32 len, string_t *dest) {
+    char *data = cursor_take(cursor, len);
+    if(!data) {
+        return false;
+    }
+
+    dest->len = 0;
+    string_reserve(dest, len + 1);
+    memcpy(dest->data, data, len);
+    dest->len = len;
+
+    return true;
+}
+
+static bool
+read_dependency(struct cache_cursor *cursor, string_t *path) {
+    struct cache_dependency *dependency = cursor_take(cursor, sizeof(*dependency));
+    if(!dependency || !cursor_take_string(cursor, dependency->path_len, path)) {
+        return false;
+    }
+
+    u64 size;
+    i64 mtime;
+    return stat_file(string_c_string_view(path), &size, &mtime) && size == dependency->size &&
+            mtime == dependency->mtime;
+}
+
+static struct material *
+read_material(struct assets_manager *manager, struct cache_cursor *cursor) {
+    struct mesh_cache_material *this = cursor_take(cursor, sizeof(*this));
+    if(!this) {
+        return NULL;
+    }
+
+    struct material *material = alloc(sizeof(*material));
+    if(!cursor_take_string(cursor, this->name_len, &material->name)) {
+        goto err;
+    }
+
+    material->diffuse_color = this->diffuse_color;
+    material->specular_color = this->specular_color;
+    material->ambient_color = this->ambient_color;
+    material->shininess = this->shininess;
+    material->opacity = this->opacity;
+    material->illumination_model = this->illumination_model;
+
+    if(this->texture_len > 0) {
+        string_t path = {0};
+        if(!cursor_take_string(cursor, this->texture_len, &path)) {
+            goto err;
+        }
+
+        material->texture = assets_manager_get_texture(manager, &path);
+        string_deinit(&path);
+    }
+
+    return material;
+
+err:
+    material_destroy(material);
+    return NULL;
+}
+
+// the use materials refer to the materials by their index in `materials`
+static bool
+read_use_materials(struct cache_cursor *cursor, i32 len, struct material **materials, u32 materials_len,
+        use_material_array_t *dest) {
+    struct mesh_cache_use_material *uses = cursor_take(cursor, len * sizeof(*uses));
+    if(!uses && len > 0) {
+        return false;
+    }
+
+    for(i32 i = 0; i < len; i++) {
+        if(uses[i].material < 0 || (u32)uses[i].material >= materials_len) {
+            return false;
+        }
+
+        use_material_array_push(dest,
+                (struct use_material){
+                        .face_index = uses[i].face_index,
+                        .material = materials[uses[i].material],
+                });
+    }
+
+    return true;
+}
+
+// points the array at the next `len` elements of the file, without taking ownership of them
+#define cursor_take_array(cursor, array, count)                                \
+    ((array)->data = cursor_take((cursor), (count) * sizeof(*(array)->data)), \
+            (array)->len = (count), (array)->cap = 0, (array)->data != NULL || (count) == 0)
+
+struct mesh *
+mesh_cache_load(struct assets_manager *manager, char *path, bool quantized) {
+    string_t cache = {0};
+    if(!cache_path(path, mesh_cache_extension(quantized), &cache)) {
+        return NULL;
+    }
+
+    int fd = open(string_c_string_view(&cache), O_RDONLY | O_CLOEXEC);
+    string_deinit(&cache);
+    if(fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    // private and writable, so the mesh can still be modified in place (the file is never written back)
+    char *data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) {
+        return NULL;
+    }
+
+    struct mesh *mesh = alloc(sizeof(*mesh));
+    string_init(&mesh->path, path);
+    list_init(&mesh->materials);
+    mesh->cache = data;
+    mesh->cache_len = st.st_size;
+
+    struct cache_cursor cursor = {data, data + st.st_size};
+    struct mesh_cache_header *header = cursor_take(&cursor, sizeof(*header));
+
+    u64 size;
+    i64 mtime;
+    if(!header || memcmp(header->magic, mesh_magic, sizeof(mesh_magic)) != 0 || header->version != CACHE_VERSION ||
+            !stat_file(path, &size, &mtime) || size != header->source_size || mtime != header->source_mtime ||
+            header->quantized != quantized) {
+        goto err;
+    }
+
+    mesh->quantized = quantized;
+    mesh->vertices_min = header->vertices_min;
+    mesh->vertices_scale = header->vertices_scale;
+    mesh->textures_min = header->textures_min;
+    mesh->textures_scale = header->textures_scale;
+    mesh->center = header->center;
+    mesh->radius = header->radius;
+
+    for(u32 i = 0; i < header->dependencies_len; i++) {
+        string_t library = {0};
+        bool ok = read_dependency(&cursor, &library);
+        string_array_push(&mesh->material_libraries, library);
+        if(!ok) {
+            goto err;
+        }
+    }
+
+    struct material **materials = alloc((header->materials_len + 1) * sizeof(*materials));
+    for(u32 i = 0; i < header->materials_len; i++) {
+        materials[i] = read_material(manager, &cursor);
+        if(!materials[i]) {
+            for(u32 j = 0; j < i; j++) {
+                material_destroy(materials[j]);
+            }
+            free(materials);
+            goto err;
+        }
+    }
+
+    // added to the front one by one, so going backwards keeps them in the same order as when they were written
+    for(u32 i = header->materials_len; i-- > 0;) {
+        mesh_add_material(mesh, materials[i]);
+    }
+
+    bool ok = read_use_materials(&cursor, header->use_materials_len, materials, header->materials_len,
+            &mesh->use_materials);
+    if(quantized) {
+        ok = ok && cursor_take_array(&cursor, &mesh->packed_vertices, header->vertices_len) &&
+                cursor_take_array(&cursor, &mesh->packed_normals, header->normals_len) &&
+                cursor_take_array(&cursor, &mesh->packed_textures, header->textures_len);
+    } else {
+        ok = ok && cursor_take_array(&cursor, &mesh->vertices, header->vertices_len) &&
+                cursor_take_array(&cursor, &mesh->normals, header->normals_len) &&
+                cursor_take_array(&cursor, &mesh->textures, header->textures_len);
+    }
+    if(!ok || !cursor_take_array(&cursor, &mesh->faces, header->faces_len) || header->lods_len > MESH_MAX_LODS) {
+        free(materials);
+        goto err;
+    }
+
+    for(u32 i = 0; i < header->lods_len; i++) {
+        struct mesh_cache_lod *this = cursor_take(&cursor, sizeof(*this));
+        struct mesh_lod *lod = &mesh->lods[mesh->lods_len++];
+        if(!this || this->vertices_len > header->vertices_len || this->normals_len > header->normals_len ||
+                !read_use_materials(&cursor, this->use_materials_len, materials, header->materials_len,
+                        &lod->use_materials) ||
+                !cursor_take_array(&cursor, &lod->faces, this->faces_len)) {
+            free(materials);
+            goto err;
+        }
+
+        lod->vertices_len = this->vertices_len;
+        lod->normals_len = this->normals_len;
+        lod->error = this->error;
+    }
+    free(materials);
+
+    return mesh;
+
+err:
+    // the arrays may already point into the mapping, which `mesh_destroy()` knows not to free
+    mesh_destroy(mesh);
+    return NULL;
+}
+
+// the size of the texture data after the header
+static size_t
+texture_cache_data_size(struct texture_cache_header *header) {
+    size_t len = 0;
+    for(u32 i = 0; i < header->levels_len; i++) {
+        size_t level = (size_t)header->levels[i].width * header->levels[i].height * 4;
+        len += (level + CACHE_ALIGNMENT - 1) / CACHE_ALIGNMENT * CACHE_ALIGNMENT;
+    }
+
+    return len;
+}
+
+// textures with and without mipmaps are kept apart, so switching between them does not throw the other one away
+static char *
+texture_cache_extension(bool mipmaps) {
+    return mipmaps ? "mips.tex" : "tex";
+}
+
+bool
+texture_cache_load(struct texture *texture, bool mipmaps) {
+    // see `assets_manager_get_texture()`
+    char *path = texture->path.data;
+
+    string_t cache = {0};
+    if(!cache_path(path, texture_cache_extension(mipmaps), &cache)) {
+        return false;
+    }
+
+    int fd = open(string_c_string_view(&cache), O_RDONLY | O_CLOEXEC);
+    string_deinit(&cache);
+    if(fd < 0) {
+        return false;
+    }
+
+    struct stat st, source;
+    struct texture_cache_header header;
+    if(fstat(fd, &st) != 0 || stat(path, &source) != 0 || read(fd, &header, sizeof(header)) != sizeof(header)) {
+        goto err;
+    }
+
+    if(memcmp(header.magic, texture_magic, sizeof(texture_magic)) != 0 || header.version != CACHE_VERSION ||
+            header.source_dev != (u64)source.st_dev || header.source_ino != (u64)source.st_ino ||
+            header.source_size != (u64)source.st_size || header.source_mtime != stat_mtime(&source)) {
+        goto err;
+    }
+
+    // make sure it really is the whole mip chain, or none of it
+    int levels = 1;
+    for(int w = header.levels[0].width, h = header.levels[0].height; mipmaps && (w > 1 || h > 1); levels++) {
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+    if(header.levels_len != (u32)min(levels, TEXTURE_MAX_LEVELS)) {
+        goto err;
+    }
+
+    size_t offset = (sizeof(header) + CACHE_ALIGNMENT - 1) / CACHE_ALIGNMENT * CACHE_ALIGNMENT;
+    size_t len = offset + texture_cache_data_size(&header);
+    if((size_t)st.st_size < len) {
+        goto err;
+    }
+
+    char *data = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) {
+        return false;
+    }
+
+    texture->cache = data;
+    texture->cache_len = len;
+    texture->levels_len = header.levels_len;
+
+    struct cache_cursor cursor = {data + offset, data + len};
+    for(u32 i = 0; i < header.levels_len; i++) {
+        struct texture_level *level = &texture->levels[i];
+        level->width = header.levels[i].width;
+        level->height = header.levels[i].height;
+        level->pixels = cursor_take(&cursor, (size_t)level->width * level->height * 4);
+    }
+
+    return true;
+
+err:
+    close(fd);
+    return false;
+}
+
+bool
+texture_cache_store(struct texture *texture) {
+    char *source = texture->path.data;
+
+    string_t path = {0}, tmp = {0};
+    if(!cache_path(source, texture_cache_extension(texture->levels_len > 1), &path)) {
+        return false;
+    }
+
+    bool ret = false;
+    struct stat st;
+    if(stat(source, &st) != 0) {
+        goto out;
+    }
+
+    struct texture_cache_header header = {
+            .version = CACHE_VERSION,
+            .source_dev = st.st_dev,
+            .source_ino = st.st_ino,
+            .source_size = st.st_size,
+            .source_mtime = stat_mtime(&st),
+            .levels_len = texture->levels_len,
+    };
+    memcpy(header.magic, texture_magic, sizeof(texture_magic));
+    for(int i = 0; i < texture->levels_len; i++) {
+        header.levels[i].width = texture->levels[i].width;
+        header.levels[i].height = texture->levels[i].height;
+    }
+
+    // see `mesh_cache_store()`
+    string_clone(&tmp, &path);
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%d.tmp", (int)getpid());
+    string_append_c_string(&tmp, suffix);
+
+    FILE *f = fopen(string_c_string_view(&tmp), "wb");
+    if(!f) {
+        goto out;
+    }
+
+    bool ok = write_padded(f, &header, sizeof(header));
+    for(int i = 0; ok && i < texture->levels_len; i++) {
+        struct texture_level *level = &texture->levels[i];
+        ok = write_padded(f, level->pixels, (size_t)level->width * level->height * 4);
+    }
+
+    ok = fclose(f) == 0 && ok;
+    if(ok && rename(string_c_string_view(&tmp), string_c_string_view(&path)) == 0) {
+        ret = true;
+    } else {
+        unlink(string_c_string_view(&tmp));
+    }
+
+out:
+    string_deinit(&tmp);
+    string_deinit(&path);
+
+    return ret;
+}
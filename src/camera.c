@@ -70,3 +70,11 @@ camera_update_orientation(struct camera *camera, float dx, float dy) {
     // and compute the new normal vectors
     camera_compute_normals(camera);
 }
+
+void
+camera_set_orientation(struct camera *camera, float pitch, float yaw) {
+    camera->pitch = clamp(pitch, -M_PI_2, +M_PI_2);
+    camera->yaw = yaw;
+
+    camera_compute_normals(camera);
+}
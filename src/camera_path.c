@@ -0,0 +1,58 @@
+#include "camera_path.h"
+
+#include "dynamic_string.h"
+#include "reader.h"
+
+bool
+camera_path_load(struct camera_path *path, char *file) {
+    struct reader *r = reader_create(file);
+    if(!r) {
+        return false;
+    }
+
+    camera_key_array_init(&path->keys, 0, NULL);
+
+    bool ret = true;
+    string_t line = {0};
+    while(reader_read_line(r, &line)) {
+        char *s = string_c_string_view(&line);
+        if(line.len == 0 || s[0] == '#') {
+            continue;
+        }
+
+        struct camera_key key;
+        if(sscanf(s, "%f %f %f %f %f", &key.pos.x, &key.pos.y, &key.pos.z, &key.pitch, &key.yaw) != 5) {
+            ret = false;
+            break;
+        }
+        camera_key_array_push(&path->keys, key);
+    }
+
+    string_deinit(&line);
+    reader_destroy(r);
+
+    if(!ret || path->keys.len == 0) {
+        camera_key_array_deinit(&path->keys);
+        return false;
+    }
+
+    return true;
+}
+
+void
+camera_path_deinit(struct camera_path *path) {
+    camera_key_array_deinit(&path->keys);
+}
+
+void
+camera_path_apply(struct camera_path *path, int frame, struct camera *camera) {
+    struct camera_key *key = &path->keys.data[frame % path->keys.len];
+
+    camera->pos = key->pos;
+    camera_set_orientation(camera, key->pitch, key->yaw);
+}
+
+void
+camera_path_record(FILE *f, struct camera *camera) {
+    fprintf(f, "%f %f %f %f %f\n", camera->pos.x, camera->pos.y, camera->pos.z, camera->pitch, camera->yaw);
+}
@@ -0,0 +1,205 @@
+#include "command_buffer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "dynamic_string.h"
+#include "ints.h"
+#include "macros.h"
+
+// bump this whenever the layout of the file changes
+#define COMMAND_BUFFER_VERSION 1
+
+static char magic[4] = {'R', 'C', 'M', 'D'};
+
+struct command_buffer_header {
+    char magic[4];
+    u32 version;
+
+    float pos[3];
+    float pitch, yaw, fov;
+    i32 width, height;
+
+    u32 meshes_len;
+    u32 commands_len;
+
+    // followed by the paths of the meshes, each as a u32 length and then the path, and then the commands
+};
+
+struct command_buffer_entry {
+    // in the order the meshes are stored in
+    u32 mesh;
+    i32 lod;
+    float pos[3];
+    float rot[3][3];
+    float scale;
+    float tint[3];
+    u32 tinted;
+};
+
+void
+command_buffer_deinit(struct command_buffer *buffer) {
+    render_command_array_deinit(&buffer->commands);
+}
+
+void
+command_buffer_apply_camera(struct command_buffer *buffer, struct camera *camera) {
+    camera->pos = buffer->pos;
+    camera->fov = buffer->fov;
+    camera_set_orientation(camera, buffer->pitch, buffer->yaw);
+}
+
+// the index of the mesh among `meshes`, adding it if it is not there yet
+static u32
+mesh_index(struct mesh ***meshes, int *len, struct mesh *mesh) {
+    for(int i = 0; i < *len; i++) {
+        if((*meshes)[i] == mesh) {
+            return i;
+        }
+    }
+
+    *meshes = realloc(*meshes, (*len + 1) * sizeof(**meshes));
+    (*meshes)[*len] = mesh;
+    return (*len)++;
+}
+
+bool
+command_buffer_write(struct command_buffer *buffer, char *path) {
+    struct mesh **meshes = NULL;
+    int meshes_len = 0;
+    struct command_buffer_entry *entries = alloc(max(buffer->commands.len, 1) * sizeof(*entries));
+    int entries_len = 0;
+
+    for(struct render_command *command = buffer->commands.data;
+            command < render_command_array_end(&buffer->commands); command++) {
+        if(command->mesh->path.len == 0) {
+            continue;
+        }
+
+        struct transform *t = &command->transform;
+        struct command_buffer_entry *entry = &entries[entries_len++];
+        *entry = (struct command_buffer_entry){
+                .mesh = mesh_index(&meshes, &meshes_len, command->mesh),
+                .lod = command->lod,
+                .pos = {t->pos.x, t->pos.y, t->pos.z},
+                .scale = t->scale,
+                .tint = {command->tint.x, command->tint.y, command->tint.z},
+                .tinted = command->tinted,
+        };
+        memcpy(entry->rot, t->rot.m, sizeof(entry->rot));
+    }
+
+    struct command_buffer_header header = {
+            .version = COMMAND_BUFFER_VERSION,
+            .pos = {buffer->pos.x, buffer->pos.y, buffer->pos.z},
+            .pitch = buffer->pitch,
+            .yaw = buffer->yaw,
+            .fov = buffer->fov,
+            .width = buffer->width,
+            .height = buffer->height,
+            .meshes_len = meshes_len,
+            .commands_len = entries_len,
+    };
+    memcpy(header.magic, magic, sizeof(magic));
+
+    bool ret = false;
+    FILE *f = fopen(path, "wb");
+    if(!f) {
+        goto out;
+    }
+
+    if(fwrite(&header, sizeof(header), 1, f) != 1) {
+        goto out;
+    }
+    for(int i = 0; i < meshes_len; i++) {
+        u32 len = meshes[i]->path.len;
+        if(fwrite(&len, sizeof(len), 1, f) != 1 || fwrite(meshes[i]->path.data, 1, len, f) != len) {
+            goto out;
+        }
+    }
+    if(fwrite(entries, sizeof(*entries), entries_len, f) != (size_t)entries_len) {
+        goto out;
+    }
+    ret = true;
+
+out:
+    if(f && fclose(f) != 0) {
+        ret = false;
+    }
+    free(entries);
+    free(meshes);
+    return ret;
+}
+
+bool
+command_buffer_read(struct command_buffer *buffer, struct assets_manager *manager, char *path) {
+    FILE *f = fopen(path, "rb");
+    if(!f) {
+        return false;
+    }
+
+    struct mesh **meshes = NULL;
+    string_t mesh_path = {0};
+    bool ret = false;
+
+    struct command_buffer_header header;
+    if(fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, magic, sizeof(magic)) != 0 ||
+            header.version != COMMAND_BUFFER_VERSION) {
+        goto out;
+    }
+
+    meshes = alloc(max(header.meshes_len, 1) * sizeof(*meshes));
+    for(u32 i = 0; i < header.meshes_len; i++) {
+        u32 len;
+        if(fread(&len, sizeof(len), 1, f) != 1) {
+            goto out;
+        }
+        string_reserve(&mesh_path, len + 1);
+        if(fread(mesh_path.data, 1, len, f) != len) {
+            goto out;
+        }
+        mesh_path.len = len;
+
+        meshes[i] = assets_manager_load_mesh(manager, string_c_string_view(&mesh_path));
+        if(!meshes[i]) {
+            goto out;
+        }
+    }
+
+    *buffer = (struct command_buffer){
+            .pos = {header.pos[0], header.pos[1], header.pos[2]},
+            .pitch = header.pitch,
+            .yaw = header.yaw,
+            .fov = header.fov,
+            .width = header.width,
+            .height = header.height,
+    };
+    render_command_array_reserve(&buffer->commands, header.commands_len);
+    for(u32 i = 0; i < header.commands_len; i++) {
+        struct command_buffer_entry entry;
+        if(fread(&entry, sizeof(entry), 1, f) != 1 || entry.mesh >= header.meshes_len) {
+            command_buffer_deinit(buffer);
+            goto out;
+        }
+
+        struct mesh *mesh = meshes[entry.mesh];
+        struct render_command command = {
+                .mesh = mesh,
+                // the mesh might have been simplified differently since
+                .lod = clamp(entry.lod, 0, mesh->lods_len + 1),
+                .transform = {{entry.pos[0], entry.pos[1], entry.pos[2]}, .scale = entry.scale},
+                .tint = {entry.tint[0], entry.tint[1], entry.tint[2]},
+                .tinted = entry.tinted,
+        };
+        memcpy(command.transform.rot.m, entry.rot, sizeof(entry.rot));
+        render_command_array_push(&buffer->commands, command);
+    }
+    ret = true;
+
+out:
+    string_deinit(&mesh_path);
+    free(meshes);
+    fclose(f);
+    return ret;
+}
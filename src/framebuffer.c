@@ -0,0 +1,204 @@
+#include "framebuffer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "color.h"
+#include "macros.h"
+#include "render.h"
+
+struct framebuffer *
+framebuffer_create(int width, int height) {
+    struct framebuffer *framebuffer = alloc(sizeof(*framebuffer));
+    framebuffer->width = width;
+    framebuffer->height = height;
+    framebuffer->pixels = alloc(width * height * sizeof(*framebuffer->pixels));
+    framebuffer->depth = alloc(width * height * sizeof(*framebuffer->depth));
+    framebuffer->renderer = renderer_create();
+
+    return framebuffer;
+}
+
+void
+framebuffer_destroy(struct framebuffer *framebuffer) {
+    free(framebuffer->pixels);
+    free(framebuffer->depth);
+    renderer_destroy(framebuffer->renderer);
+    free(framebuffer);
+}
+
+void
+framebuffer_render(struct framebuffer *framebuffer, struct scene_tree *scene, struct camera *camera) {
+    camera_update_viewport(camera, framebuffer->width, framebuffer->height);
+    render(framebuffer->renderer, scene, camera, framebuffer->pixels, framebuffer->depth);
+}
+
+void
+framebuffer_record(struct framebuffer *framebuffer, struct scene_tree *scene, struct camera *camera,
+        struct command_buffer *dest) {
+    camera_update_viewport(camera, framebuffer->width, framebuffer->height);
+    render_record(framebuffer->renderer, scene, camera, framebuffer->pixels, framebuffer->depth, dest);
+}
+
+void
+framebuffer_render_commands(struct framebuffer *framebuffer, struct command_buffer *commands, struct camera *camera) {
+    camera_update_viewport(camera, framebuffer->width, framebuffer->height);
+    render_commands(framebuffer->renderer, commands, camera, framebuffer->pixels, framebuffer->depth);
+}
+
+static void
+pixel_to_rgb(u32 pixel, u8 *dest) {
+    dest[0] = color_get_red(pixel);
+    dest[1] = color_get_green(pixel);
+    dest[2] = color_get_blue(pixel);
+}
+
+bool
+framebuffer_write_ppm(struct framebuffer *framebuffer, char *path) {
+    FILE *f = fopen(path, "wb");
+    if(!f) {
+        return false;
+    }
+
+    fprintf(f, "P6\n%d %d\n255\n", framebuffer->width, framebuffer->height);
+
+    u8 *row = alloc(framebuffer->width * 3);
+    for(int y = 0; y < framebuffer->height; y++) {
+        for(int x = 0; x < framebuffer->width; x++) {
+            pixel_to_rgb(framebuffer->pixels[y * framebuffer->width + x], &row[x * 3]);
+        }
+        fwrite(row, 3, framebuffer->width, f);
+    }
+    free(row);
+
+    bool ret = !ferror(f);
+    return fclose(f) == 0 && ret;
+}
+
+static u32
+crc32_update(u32 crc, u8 *data, size_t len) {
+    static u32 table[256];
+    static bool has_table = false;
+    if(!has_table) {
+        for(u32 i = 0; i < 256; i++) {
+            u32 c = i;
+            for(int k = 0; k < 8; k++) {
+                c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        has_table = true;
+    }
+
+    crc = ~crc;
+    for(size_t i = 0; i < len; i++) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+static void
+put_u32_be(u8 *dest, u32 v) {
+    dest[0] = v >> 24;
+    dest[1] = v >> 16;
+    dest[2] = v >> 8;
+    dest[3] = v;
+}
+
+static void
+png_write_chunk(FILE *f, char *type, u8 *data, u32 len) {
+    u8 header[8];
+    put_u32_be(header, len);
+    memcpy(header + 4, type, 4);
+    fwrite(header, 1, 8, f);
+
+    // chunks like IEND have no data at all, and NULL is not a valid buffer even for 0 bytes
+    u32 crc = crc32_update(0, (u8 *)type, 4);
+    if(len) {
+        fwrite(data, 1, len, f);
+        crc = crc32_update(crc, data, len);
+    }
+
+    u8 footer[4];
+    put_u32_be(footer, crc);
+    fwrite(footer, 1, 4, f);
+}
+
+// the image data is stored in uncompressed deflate blocks; the files are bigger than they could be, but we dont need a
+// compression library for what is a debugging and testing output
+bool
+framebuffer_write_png(struct framebuffer *framebuffer, char *path) {
+    FILE *f = fopen(path, "wb");
+    if(!f) {
+        return false;
+    }
+
+    static u8 signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    fwrite(signature, 1, sizeof(signature), f);
+
+    u8 ihdr[13] = {0};
+    put_u32_be(&ihdr[0], framebuffer->width);
+    put_u32_be(&ihdr[4], framebuffer->height);
+    ihdr[8] = 8;  // bit depth
+    ihdr[9] = 2;  // truecolor rgb
+    png_write_chunk(f, "IHDR", ihdr, sizeof(ihdr));
+
+    // every row is prefixed by its filter type, which is always none here
+    size_t stride = framebuffer->width * 3 + 1;
+    size_t raw_len = stride * framebuffer->height;
+    u8 *raw = alloc(raw_len);
+    for(int y = 0; y < framebuffer->height; y++) {
+        u8 *row = &raw[y * stride];
+        for(int x = 0; x < framebuffer->width; x++) {
+            pixel_to_rgb(framebuffer->pixels[y * framebuffer->width + x], &row[1 + x * 3]);
+        }
+    }
+
+    size_t blocks = (raw_len + 0xffff - 1) / 0xffff;
+    size_t idat_len = 2 + blocks * 5 + raw_len + 4;
+    u8 *idat = alloc(idat_len);
+    u8 *p = idat;
+
+    // zlib header: deflate with a 32k window, no preset dictionary
+    *p++ = 0x78;
+    *p++ = 0x01;
+
+    u32 a = 1, b = 0;
+    for(size_t offset = 0; offset < raw_len; offset += 0xffff) {
+        u16 len = min(raw_len - offset, 0xffff);
+        *p++ = offset + len == raw_len;
+        *p++ = len & 0xff;
+        *p++ = len >> 8;
+        *p++ = ~len & 0xff;
+        *p++ = (u16)~len >> 8;
+        memcpy(p, &raw[offset], len);
+        p += len;
+
+        for(int i = 0; i < len; i++) {
+            a = (a + raw[offset + i]) % 65521;
+            b = (b + a) % 65521;
+        }
+    }
+    put_u32_be(p, (b << 16) | a);
+
+    png_write_chunk(f, "IDAT", idat, idat_len);
+    png_write_chunk(f, "IEND", NULL, 0);
+
+    free(idat);
+    free(raw);
+
+    bool ret = !ferror(f);
+    return fclose(f) == 0 && ret;
+}
+
+bool
+framebuffer_write(struct framebuffer *framebuffer, char *path) {
+    char *ext = strrchr(path, '.');
+    if(ext && strcmp(ext, ".png") == 0) {
+        return framebuffer_write_png(framebuffer, path);
+    }
+
+    return framebuffer_write_ppm(framebuffer, path);
+}
@@ -0,0 +1,153 @@
+#include "impostor.h"
+
+#include <math.h>
+
+#include "alloc.h"
+#include "camera.h"
+#include "color.h"
+#include "render.h"
+#include "scene.h"
+
+// the pictures are taken from far away through a narrow field of view, so they come out close to how the mesh looks
+// from the distances the impostor is drawn at
+#define IMPOSTOR_FOV (10.0f * (float)M_PI / 180.0f)
+
+static void
+texture_init_empty(struct texture *texture, int width, int height) {
+    texture->width = width;
+    texture->height = height;
+    texture->pixels = alloc(width * height * 4);
+
+    texture->levels[0] = (struct texture_level){width, height, texture->pixels};
+    texture->levels_len = 1;
+}
+
+// copies the pixels the mesh covers to the picture's place in the texture, the rest is left transparent. the normals
+// of surfaces that have none come out black, so with `black_is_empty` those are left transparent too
+static void
+copy_tile(struct texture *texture, int index, u32 *buffer, float *depth_buffer, bool black_is_empty) {
+    int x0 = index % IMPOSTOR_ATLAS_COLUMNS * IMPOSTOR_TILE_SIZE;
+    int y0 = index / IMPOSTOR_ATLAS_COLUMNS * IMPOSTOR_TILE_SIZE;
+
+    for(int y = 0; y < IMPOSTOR_TILE_SIZE; y++) {
+        for(int x = 0; x < IMPOSTOR_TILE_SIZE; x++) {
+            int i = y * IMPOSTOR_TILE_SIZE + x;
+            u8 *texel = &texture->pixels[((y0 + y) * texture->width + x0 + x) * 4];
+
+            u32 color = buffer[i];
+            bool covered = depth_buffer[i] != INFINITY && !(black_is_empty && (color & 0xffffff) == 0);
+            texel[0] = color_get_red(color);
+            texel[1] = color_get_green(color);
+            texel[2] = color_get_blue(color);
+            texel[3] = covered ? 255 : 0;
+        }
+    }
+}
+
+static void
+view_init(struct impostor *impostor, int index, int atlas_width, int atlas_height) {
+    struct impostor_view *view = &impostor->views[index];
+
+    float yaw = (index % IMPOSTOR_YAWS) * (2.0f * M_PI / IMPOSTOR_YAWS);
+    float pitch = (index / IMPOSTOR_YAWS) * (M_PI_2 / IMPOSTOR_PITCHES);
+    view->direction = (vec3){cosf(pitch) * sinf(yaw), sinf(pitch), cosf(pitch) * cosf(yaw)};
+
+    // the same way the camera does it, only with y as up
+    vec3 normal = vec3_scale(-1.0f, view->direction);
+    view->right = vec3_normalize(vec3_cross(normal, (vec3){0.0f, 1.0f, 0.0f}));
+    view->up = vec3_cross(view->right, normal);
+
+    // half a texel in from the edges, so the pictures next to it never bleed in
+    int column = index % IMPOSTOR_ATLAS_COLUMNS, row = index / IMPOSTOR_ATLAS_COLUMNS;
+    vec2 texel = {1.0f / atlas_width, 1.0f / atlas_height};
+    vec2 size = {IMPOSTOR_TILE_SIZE * texel.x, IMPOSTOR_TILE_SIZE * texel.y};
+    view->uv_min = (vec2){column * size.x + 0.5f * texel.x, 1.0f - (row + 1) * size.y + 0.5f * texel.y};
+    view->uv_max = (vec2){(column + 1) * size.x - 0.5f * texel.x, 1.0f - row * size.y - 0.5f * texel.y};
+}
+
+struct impostor *
+impostor_create(struct mesh *mesh) {
+    struct impostor *impostor = alloc(sizeof(*impostor));
+
+    int width = IMPOSTOR_ATLAS_COLUMNS * IMPOSTOR_TILE_SIZE;
+    int height = (IMPOSTOR_VIEWS + IMPOSTOR_ATLAS_COLUMNS - 1) / IMPOSTOR_ATLAS_COLUMNS * IMPOSTOR_TILE_SIZE;
+    texture_init_empty(&impostor->colors, width, height);
+    texture_init_empty(&impostor->normals, width, height);
+
+    impostor->material = (struct material){
+            .diffuse_color = {1.0f, 1.0f, 1.0f},
+            .opacity = 1.0f,
+            .texture = &impostor->colors,
+            .normal_map = &impostor->normals,
+            .alpha_test = true,
+    };
+
+    // far enough that the whole bounding sphere just fits, and then the picture is as big as the view at its center
+    float distance = mesh->radius / sinf(0.5f * IMPOSTOR_FOV);
+    impostor->half_size = distance * tanf(0.5f * IMPOSTOR_FOV);
+
+    // a renderer of its own that always draws the full mesh, and especially never an impostor of it. the pictures are
+    // small enough that threads would not help
+    struct renderer *renderer = renderer_create();
+    renderer->lod_pixels = 0.0f;
+    renderer->impostor_pixels = 0.0f;
+    renderer->threads = 1;
+
+    struct scene_tree *scene = scene_add_tree(NULL);
+    scene_add_mesh(scene, mesh);
+
+    struct camera camera = {
+            .width = IMPOSTOR_TILE_SIZE,
+            .height = IMPOSTOR_TILE_SIZE,
+            .fov = IMPOSTOR_FOV,
+    };
+    u32 *buffer = alloc(IMPOSTOR_TILE_SIZE * IMPOSTOR_TILE_SIZE * sizeof(*buffer));
+    float *depth_buffer = alloc(IMPOSTOR_TILE_SIZE * IMPOSTOR_TILE_SIZE * sizeof(*depth_buffer));
+
+    for(int i = 0; i < IMPOSTOR_VIEWS; i++) {
+        struct impostor_view *view = &impostor->views[i];
+        view_init(impostor, i, width, height);
+
+        camera.pos = vec3_add(mesh->center, vec3_scale(distance, view->direction));
+        camera.normal = vec3_scale(-1.0f, view->direction);
+        camera.right = view->right;
+        camera.up = view->up;
+
+        renderer_set_view(renderer, RENDER_VIEW_ALBEDO);
+        render(renderer, scene, &camera, buffer, depth_buffer);
+        copy_tile(&impostor->colors, i, buffer, depth_buffer, false);
+
+        renderer_set_view(renderer, RENDER_VIEW_NORMALS);
+        render(renderer, scene, &camera, buffer, depth_buffer);
+        copy_tile(&impostor->normals, i, buffer, depth_buffer, true);
+    }
+
+    free(depth_buffer);
+    free(buffer);
+    scene_node_remove(&scene->node);
+    renderer_destroy(renderer);
+
+    return impostor;
+}
+
+void
+impostor_destroy(struct impostor *impostor) {
+    free(impostor->colors.pixels);
+    free(impostor->normals.pixels);
+    free(impostor);
+}
+
+int
+impostor_select_view(struct impostor *impostor, vec3 direction) {
+    int best = 0;
+    float best_dot = -INFINITY;
+    for(int i = 0; i < IMPOSTOR_VIEWS; i++) {
+        float dot = vec3_dot(impostor->views[i].direction, direction);
+        if(dot > best_dot) {
+            best = i;
+            best_dot = dot;
+        }
+    }
+
+    return best;
+}
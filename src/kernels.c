@@ -0,0 +1,124 @@
+#include "kernels.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "macros.h"
+
+// every variant is the same code from `kernels_impl.h`, only compiled for a different instruction set and vector width.
+// note: avx512f implies fma, so contraction is turned off for all of them to make them produce exactly the same image
+#pragma GCC optimize("fp-contract=off")
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNELS_X86 1
+#else
+#define KERNELS_X86 0
+#endif
+
+#if KERNELS_X86
+// sse2 is part of the x86-64 baseline, so this one needs no target options
+#define KERNEL_SUFFIX sse2
+#define KERNEL_NAME "sse2"
+#define KERNEL_LANES 4
+#include "kernels_impl.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_NAME
+#undef KERNEL_LANES
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#define KERNEL_SUFFIX avx2
+#define KERNEL_NAME "avx2"
+#define KERNEL_LANES 8
+#include "kernels_impl.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_NAME
+#undef KERNEL_LANES
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#define KERNEL_SUFFIX avx512
+#define KERNEL_NAME "avx512"
+#define KERNEL_LANES 16
+#include "kernels_impl.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_NAME
+#undef KERNEL_LANES
+#pragma GCC pop_options
+#else
+// whatever the compiler makes out of 4 wide vectors on this architecture
+#define KERNEL_SUFFIX generic
+#define KERNEL_NAME "generic"
+#define KERNEL_LANES 4
+#include "kernels_impl.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_NAME
+#undef KERNEL_LANES
+#endif
+
+// ordered from the best to the worst. note: avx512 comes after avx2, since most triangles only cover a few pixels per
+// row and 16 lanes end up mostly masked off, which made it slower on every benchmark scene
+static const struct render_kernels *variants[] = {
+#if KERNELS_X86
+        &kernels_avx2,
+        &kernels_avx512,
+        &kernels_sse2,
+#else
+        &kernels_generic,
+#endif
+};
+
+static bool
+is_supported(const struct render_kernels *kernels) {
+#if KERNELS_X86
+    __builtin_cpu_init();
+    if(kernels == &kernels_avx512) {
+        return __builtin_cpu_supports("avx512f");
+    } else if(kernels == &kernels_avx2) {
+        return __builtin_cpu_supports("avx2");
+    }
+#endif
+    unused(kernels);
+    return true;
+}
+
+static const struct render_kernels *selected;
+static pthread_once_t selected_once = PTHREAD_ONCE_INIT;
+
+static void
+select_kernels(void) {
+    char *name = getenv("RASTERIZER_ISA");
+
+    for(size_t i = 0; i < sizeof(variants) / sizeof(variants[0]); i++) {
+        const struct render_kernels *kernels = variants[i];
+        if(!is_supported(kernels)) {
+            continue;
+        }
+
+        if(!name || strcmp(name, kernels->name) == 0) {
+            selected = kernels;
+            return;
+        }
+    }
+
+    // the requested one is either unknown or not supported here, so fall back to the best we have
+    for(size_t i = 0; i < sizeof(variants) / sizeof(variants[0]); i++) {
+        if(is_supported(variants[i])) {
+            selected = variants[i];
+            break;
+        }
+    }
+
+    fprintf(stderr, "kernels: '%s' is not available on this cpu, using '%s'\n", name, selected->name);
+}
+
+const struct render_kernels *
+kernels_get(void) {
+    pthread_once(&selected_once, select_kernels);
+
+    return selected;
+}
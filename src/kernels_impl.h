@@ -0,0 +1,202 @@
+// the kernel implementations, written once in terms of gcc vector extensions and included by `kernels.c` once for every
+// instruction set with `KERNEL_SUFFIX` and `KERNEL_LANES` defined. this is not a standalone header
+
+#define KERNEL_CONCAT_(a, b) a##_##b
+#define KERNEL_CONCAT(a, b) KERNEL_CONCAT_(a, b)
+#define KERNEL(name) KERNEL_CONCAT(name, KERNEL_SUFFIX)
+
+typedef float KERNEL(vfloat) __attribute__((vector_size(KERNEL_LANES * sizeof(float))));
+typedef i32 KERNEL(vint) __attribute__((vector_size(KERNEL_LANES * sizeof(i32))));
+typedef u32 KERNEL(vu32) __attribute__((vector_size(KERNEL_LANES * sizeof(u32))));
+
+static void
+KERNEL(clear)(u32 *buffer, float *depth_buffer, int len, u32 color) {
+    KERNEL(vu32) colors = {0};
+    colors += color;
+    KERNEL(vfloat) depths = {0};
+    depths += INFINITY;
+
+    int i = 0;
+    for(; i + KERNEL_LANES <= len; i += KERNEL_LANES) {
+        memcpy(&buffer[i], &colors, sizeof(colors));
+        memcpy(&depth_buffer[i], &depths, sizeof(depths));
+    }
+
+    for(; i < len; i++) {
+        buffer[i] = color;
+        depth_buffer[i] = INFINITY;
+    }
+}
+
+// projects one batch of points that was already gathered into lanes, writing the first `n` of them at `i`
+static inline void
+KERNEL(project_lanes)(float m[3][4], float cx, float cy, KERNEL(vfloat) x, KERNEL(vfloat) y, KERNEL(vfloat) z,
+        vec2 *screen, float *depths, int i, int n) {
+    KERNEL(vfloat) sx = m[0][0] * x + m[0][1] * y + m[0][2] * z + m[0][3];
+    KERNEL(vfloat) sy = m[1][0] * x + m[1][1] * y + m[1][2] * z + m[1][3];
+    KERNEL(vfloat) sz = m[2][0] * x + m[2][1] * y + m[2][2] * z + m[2][3];
+
+    // points behind the camera get garbage coordinates here, but they are rejected by their depth anyway
+    sx = sx / sz + cx;
+    sy = sy / sz + cy;
+
+    for(int j = 0; j < n; j++) {
+        screen[i + j] = (vec2){sx[j], sy[j]};
+        depths[i + j] = sz[j];
+    }
+}
+
+static void
+KERNEL(project)(float m[3][4], float cx, float cy, vec3 *points, vec2 *screen, float *depths, int len) {
+    for(int i = 0; i < len; i += KERNEL_LANES) {
+        int n = min(KERNEL_LANES, len - i);
+
+        // the points are stored interleaved, so gather them lane by lane
+        KERNEL(vfloat) x = {0}, y = {0}, z = {0};
+        for(int j = 0; j < n; j++) {
+            x[j] = points[i + j].x;
+            y[j] = points[i + j].y;
+            z[j] = points[i + j].z;
+        }
+
+        KERNEL(project_lanes)(m, cx, cy, x, y, z, screen, depths, i, n);
+    }
+}
+
+static void
+KERNEL(project_packed)(float m[3][4], float cx, float cy, u16vec3 *points, vec2 *screen, float *depths, int len) {
+    for(int i = 0; i < len; i += KERNEL_LANES) {
+        int n = min(KERNEL_LANES, len - i);
+
+        KERNEL(vfloat) x = {0}, y = {0}, z = {0};
+        for(int j = 0; j < n; j++) {
+            x[j] = points[i + j].x;
+            y[j] = points[i + j].y;
+            z[j] = points[i + j].z;
+        }
+
+        KERNEL(project_lanes)(m, cx, cy, x, y, z, screen, depths, i, n);
+    }
+}
+
+static inline void
+KERNEL(transform_lanes)(mat3 *m, KERNEL(vfloat) x, KERNEL(vfloat) y, KERNEL(vfloat) z, vec3 *dest, int i, int n) {
+    KERNEL(vfloat) tx = m->m[0][0] * x + m->m[0][1] * y + m->m[0][2] * z;
+    KERNEL(vfloat) ty = m->m[1][0] * x + m->m[1][1] * y + m->m[1][2] * z;
+    KERNEL(vfloat) tz = m->m[2][0] * x + m->m[2][1] * y + m->m[2][2] * z;
+
+    for(int j = 0; j < n; j++) {
+        dest[i + j] = (vec3){tx[j], ty[j], tz[j]};
+    }
+}
+
+static void
+KERNEL(transform)(mat3 *m, vec3 *vectors, vec3 *dest, int len) {
+    for(int i = 0; i < len; i += KERNEL_LANES) {
+        int n = min(KERNEL_LANES, len - i);
+
+        KERNEL(vfloat) x = {0}, y = {0}, z = {0};
+        for(int j = 0; j < n; j++) {
+            x[j] = vectors[i + j].x;
+            y[j] = vectors[i + j].y;
+            z[j] = vectors[i + j].z;
+        }
+
+        KERNEL(transform_lanes)(m, x, y, z, dest, i, n);
+    }
+}
+
+static inline KERNEL(vfloat)
+KERNEL(abs)(KERNEL(vfloat) v) {
+    return (KERNEL(vfloat))((KERNEL(vint))v & 0x7fffffff);
+}
+
+// `magnitude` with the sign of `sign`, `magnitude` has to be positive
+static inline KERNEL(vfloat)
+KERNEL(copysign)(KERNEL(vfloat) magnitude, KERNEL(vfloat) sign) {
+    return (KERNEL(vfloat))((KERNEL(vint))magnitude | ((KERNEL(vint))sign & ~0x7fffffff));
+}
+
+static void
+KERNEL(transform_octahedral)(mat3 *m, i16vec2 *vectors, vec3 *dest, int len) {
+    for(int i = 0; i < len; i += KERNEL_LANES) {
+        int n = min(KERNEL_LANES, len - i);
+
+        KERNEL(vfloat) x = {0}, y = {0};
+        for(int j = 0; j < n; j++) {
+            x[j] = vectors[i + j].x;
+            y[j] = vectors[i + j].y;
+        }
+
+        // the same as `octahedral_decode()`, with the max and the sign picked through the bits
+        x /= 32767.0f;
+        y /= 32767.0f;
+        KERNEL(vfloat) z = 1.0f - KERNEL(abs)(x) - KERNEL(abs)(y);
+
+        KERNEL(vfloat) t = (KERNEL(vfloat))((KERNEL(vint))-z & (-z > 0.0f));
+        x -= KERNEL(copysign)(t, x);
+        y -= KERNEL(copysign)(t, y);
+
+        KERNEL(transform_lanes)(m, x, y, z, dest, i, n);
+    }
+}
+
+static int
+KERNEL(coverage)(struct triangle_setup *setup, int y, int start_x, int end_x, float *depth_row, int row_index,
+        struct fragment *dest) {
+    KERNEL(vfloat) lanes;
+    for(int i = 0; i < KERNEL_LANES; i++) {
+        lanes[i] = i;
+    }
+
+    // the part of the edge functions that only depends on the row
+    float py = y + 0.5f;
+    float w0_y = setup->b[0] * (py - setup->oy[0]);
+    float w1_y = setup->b[1] * (py - setup->oy[1]);
+    float w2_y = setup->b[2] * (py - setup->oy[2]);
+
+    int len = 0;
+    for(int x = start_x; x < end_x; x += KERNEL_LANES) {
+        KERNEL(vfloat) px = lanes + (x + 0.5f);
+
+        KERNEL(vfloat) alpha = setup->a[0] * (px - setup->ox[0]) + w0_y;
+        KERNEL(vfloat) beta = setup->a[1] * (px - setup->ox[1]) + w1_y;
+        KERNEL(vfloat) gamma = setup->a[2] * (px - setup->ox[2]) + w2_y;
+        KERNEL(vfloat) depth = alpha * setup->depths[0] + beta * setup->depths[1] + gamma * setup->depths[2];
+
+        // the lanes past the end of the row get a depth that nothing can pass
+        KERNEL(vfloat) current;
+        int n = end_x - x;
+        if(n >= KERNEL_LANES) {
+            memcpy(&current, &depth_row[x], sizeof(current));
+        } else {
+            for(int i = 0; i < KERNEL_LANES; i++) {
+                current[i] = i < n ? depth_row[x + i] : -INFINITY;
+            }
+        }
+
+        KERNEL(vint) mask = (alpha >= 0.0f) & (beta >= 0.0f) & (gamma >= 0.0f) & (depth < current);
+
+        for(int i = 0; i < KERNEL_LANES; i++) {
+            if(mask[i]) {
+                dest[len++] = (struct fragment){row_index + x + i, alpha[i], beta[i], gamma[i], depth[i]};
+            }
+        }
+    }
+
+    return len;
+}
+
+static const struct render_kernels KERNEL(kernels) = {
+        .name = KERNEL_NAME,
+        .clear = KERNEL(clear),
+        .project = KERNEL(project),
+        .transform = KERNEL(transform),
+        .project_packed = KERNEL(project_packed),
+        .transform_octahedral = KERNEL(transform_octahedral),
+        .coverage = KERNEL(coverage),
+};
+
+#undef KERNEL_CONCAT_
+#undef KERNEL_CONCAT
+#undef KERNEL
@@ -0,0 +1,322 @@
+#include "mesh_optimize.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "hash_map.h"
+#include "macros.h"
+
+// how many of the most recently used vertices tipsify assumes are still at hand. the renderer transforms all the
+// vertices of a mesh up front, so here it is about the faces reading their vertices from nearby memory
+#define TIPSIFY_CACHE_SIZE 16
+
+// the index of one of the attributes of a vertex, `member` is its offset in `struct vertex`
+static inline int *
+vertex_index(struct vertex *vertex, size_t member) {
+    return (int *)((char *)vertex + member);
+}
+
+// merges the elements of `data` that are bitwise the same into the first of them and points the faces at what is left,
+// returns the new number of elements
+static int
+weld(void *data, int len, size_t size, struct face_array *faces, size_t member) {
+    int cap = 1;
+    while(cap < 2 * len) {
+        cap *= 2;
+    }
+    int mask = cap - 1;
+
+    // open addressing over the elements that are kept, as their index plus one so 0 is empty
+    int *slots = alloc(cap * sizeof(*slots));
+    int *remap = alloc(max(len, 1) * sizeof(*remap));
+
+    char *bytes = data;
+    int new_len = 0;
+    for(int i = 0; i < len; i++) {
+        char *elem = bytes + i * size;
+        for(int j = hash_bytes(elem, size) & mask;; j = (j + 1) & mask) {
+            if(slots[j] == 0) {
+                // the kept elements are packed at the front, which never overwrites one that is still to be read
+                memmove(bytes + new_len * size, elem, size);
+                slots[j] = new_len + 1;
+                remap[i] = new_len++;
+                break;
+            }
+            if(memcmp(bytes + (slots[j] - 1) * size, elem, size) == 0) {
+                remap[i] = slots[j] - 1;
+                break;
+            }
+        }
+    }
+
+    for(struct face *face = faces->data; face < face_array_end(faces); face++) {
+        for(int i = 0; i < 3; i++) {
+            int *index = vertex_index(&face->vertices[i], member);
+            if(*index >= 0) {
+                *index = remap[*index];
+            }
+        }
+    }
+
+    free(remap);
+    free(slots);
+
+    return new_len;
+}
+
+// renumbers the elements of `data` in the order the faces first use them, returns how many of them are used at all
+static int
+reorder(void *data, int len, size_t size, struct face_array *faces, size_t member) {
+    int *remap = alloc(max(len, 1) * sizeof(*remap));
+    for(int i = 0; i < len; i++) {
+        remap[i] = -1;
+    }
+    char *sorted = alloc(max(len, 1) * size);
+
+    int new_len = 0;
+    for(struct face *face = faces->data; face < face_array_end(faces); face++) {
+        for(int i = 0; i < 3; i++) {
+            int *index = vertex_index(&face->vertices[i], member);
+            if(*index < 0) {
+                continue;
+            }
+
+            if(remap[*index] < 0) {
+                memcpy(sorted + new_len * size, (char *)data + *index * size, size);
+                remap[*index] = new_len++;
+            }
+            *index = remap[*index];
+        }
+    }
+    memcpy(data, sorted, new_len * size);
+
+    free(sorted);
+    free(remap);
+
+    return new_len;
+}
+
+// "fast triangle reordering for vertex locality and reduced overdraw" by sander, nehab and barczak. it fans around one
+// vertex at a time, drawing all of its remaining faces, and then moves on to a vertex of those faces that is still
+// recent enough to be at hand
+struct tipsify {
+    struct face *faces;
+    // which range of faces each face belongs to, -1 for the ones that are dropped
+    int *ranges;
+    bool *emitted;
+
+    // the faces using each vertex are `adjacency[offsets[v]]` up to `adjacency[offsets[v + 1]]`
+    int *offsets, *adjacency;
+    // how many faces of the current range that use the vertex are still left
+    int *live;
+    // when the vertex was last brought into the cache
+    int *cache_time;
+    int time;
+
+    // the vertices of the faces drawn so far, most recent last, to continue from when the current fan runs dry
+    int *dead_ends;
+    int dead_ends_len;
+};
+
+static int
+tipsify_next_fan(struct tipsify *t, int candidates, int *cursor, int end, int range) {
+    // the candidate that stays in the cache the longest while all of its faces are drawn, or failing that any of them
+    // with faces left
+    int best = -1, best_priority = -1;
+    for(int i = candidates; i < t->dead_ends_len; i++) {
+        int v = t->dead_ends[i];
+        if(t->live[v] == 0) {
+            continue;
+        }
+
+        int age = t->time - t->cache_time[v];
+        int priority = age + 2 * t->live[v] <= TIPSIFY_CACHE_SIZE ? age : 0;
+        if(priority > best_priority) {
+            best = v;
+            best_priority = priority;
+        }
+    }
+    if(best >= 0) {
+        return best;
+    }
+
+    while(t->dead_ends_len > 0) {
+        int v = t->dead_ends[--t->dead_ends_len];
+        if(t->live[v] > 0) {
+            return v;
+        }
+    }
+
+    // nothing recent is left, so start over from the first face that was not drawn yet
+    for(; *cursor < end; (*cursor)++) {
+        if(t->ranges[*cursor] != range) {
+            continue;
+        }
+
+        for(int i = 0; i < 3; i++) {
+            int v = t->faces[*cursor].vertices[i].vertex_index;
+            if(t->live[v] > 0) {
+                return v;
+            }
+        }
+    }
+
+    return -1;
+}
+
+// writes the faces in [start, end) that belong to the range to `dest` in their new order, returns how many there are
+static int
+tipsify_range(struct tipsify *t, int start, int end, int range, struct face *dest) {
+    int fan = -1;
+    for(int i = start; i < end; i++) {
+        if(t->ranges[i] != range) {
+            continue;
+        }
+
+        for(int j = 0; j < 3; j++) {
+            t->live[t->faces[i].vertices[j].vertex_index]++;
+        }
+        if(fan < 0) {
+            fan = t->faces[i].vertices[0].vertex_index;
+        }
+    }
+
+    int len = 0, cursor = start;
+    t->dead_ends_len = 0;
+    while(fan >= 0) {
+        int candidates = t->dead_ends_len;
+
+        for(int *a = &t->adjacency[t->offsets[fan]]; a < &t->adjacency[t->offsets[fan + 1]]; a++) {
+            if(t->ranges[*a] != range || t->emitted[*a]) {
+                continue;
+            }
+
+            struct face *face = &t->faces[*a];
+            dest[len++] = *face;
+            t->emitted[*a] = true;
+
+            for(int i = 0; i < 3; i++) {
+                int v = face->vertices[i].vertex_index;
+                t->dead_ends[t->dead_ends_len++] = v;
+                t->live[v]--;
+                if(t->time - t->cache_time[v] > TIPSIFY_CACHE_SIZE) {
+                    t->cache_time[v] = t->time++;
+                }
+            }
+        }
+
+        fan = tipsify_next_fan(t, candidates, &cursor, end, range);
+    }
+
+    return len;
+}
+
+static inline bool
+face_has_area(struct face *face) {
+    int a = face->vertices[0].vertex_index, b = face->vertices[1].vertex_index, c = face->vertices[2].vertex_index;
+
+    return a != b && b != c && c != a;
+}
+
+// reorders the faces within each run of faces using the same material, and drops the ones without area along the way
+static void
+reorder_faces(struct mesh *mesh) {
+    int faces_len = mesh->faces.len, vertices_len = mesh->vertices.len;
+    struct face *faces = mesh->faces.data;
+
+    // range 0 is whatever comes before the first material, range `i + 1` uses `use_materials.data[i]`
+    struct tipsify t = {
+            .faces = faces,
+            .ranges = alloc(faces_len * sizeof(*t.ranges)),
+            .emitted = alloc(faces_len * sizeof(*t.emitted)),
+            .offsets = alloc((vertices_len + 1) * sizeof(*t.offsets)),
+            .adjacency = alloc(3 * faces_len * sizeof(*t.adjacency)),
+            .live = alloc(max(vertices_len, 1) * sizeof(*t.live)),
+            .cache_time = alloc(max(vertices_len, 1) * sizeof(*t.cache_time)),
+            .time = TIPSIFY_CACHE_SIZE + 1,
+            .dead_ends = alloc(3 * faces_len * sizeof(*t.dead_ends)),
+    };
+
+    int range = 0;
+    for(int i = 0; i < faces_len; i++) {
+        while(range < mesh->use_materials.len && mesh->use_materials.data[range].face_index == i) {
+            range++;
+        }
+        t.ranges[i] = face_has_area(&faces[i]) ? range : -1;
+    }
+
+    for(int i = 0; i < faces_len; i++) {
+        if(t.ranges[i] < 0) {
+            continue;
+        }
+        for(int j = 0; j < 3; j++) {
+            t.offsets[faces[i].vertices[j].vertex_index + 1]++;
+        }
+    }
+    for(int v = 0; v < vertices_len; v++) {
+        t.offsets[v + 1] += t.offsets[v];
+    }
+    // `live` counts how many are filled in so far, the faces of every vertex stay in file order
+    for(int i = 0; i < faces_len; i++) {
+        if(t.ranges[i] < 0) {
+            continue;
+        }
+        for(int j = 0; j < 3; j++) {
+            int v = faces[i].vertices[j].vertex_index;
+            t.adjacency[t.offsets[v] + t.live[v]++] = i;
+        }
+    }
+    memset(t.live, 0, vertices_len * sizeof(*t.live));
+
+    face_array_t sorted = {0};
+    face_array_reserve(&sorted, faces_len);
+
+    // materials whose faces were all dropped, or that never had any, are dropped too
+    int use_materials_len = 0;
+    for(int r = 0; r <= mesh->use_materials.len; r++) {
+        int start = r == 0 ? 0 : mesh->use_materials.data[r - 1].face_index;
+        int end = r == mesh->use_materials.len ? faces_len : mesh->use_materials.data[r].face_index;
+
+        int len = tipsify_range(&t, start, end, r, &sorted.data[sorted.len]);
+        if(len > 0 && r > 0) {
+            struct use_material use = mesh->use_materials.data[r - 1];
+            use.face_index = sorted.len;
+            mesh->use_materials.data[use_materials_len++] = use;
+        }
+        sorted.len += len;
+    }
+    mesh->use_materials.len = use_materials_len;
+
+    face_array_deinit(&mesh->faces);
+    mesh->faces = sorted;
+
+    free(t.dead_ends);
+    free(t.cache_time);
+    free(t.live);
+    free(t.adjacency);
+    free(t.offsets);
+    free(t.emitted);
+    free(t.ranges);
+}
+
+void
+mesh_optimize(struct mesh *mesh) {
+    if(mesh->faces.len == 0) {
+        return;
+    }
+
+    size_t position = offsetof(struct vertex, vertex_index);
+    size_t normal = offsetof(struct vertex, normal_index);
+    size_t texture = offsetof(struct vertex, texture_index);
+
+    mesh->vertices.len = weld(mesh->vertices.data, mesh->vertices.len, sizeof(vec3), &mesh->faces, position);
+    mesh->normals.len = weld(mesh->normals.data, mesh->normals.len, sizeof(vec3), &mesh->faces, normal);
+    mesh->textures.len = weld(mesh->textures.data, mesh->textures.len, sizeof(vec2), &mesh->faces, texture);
+
+    reorder_faces(mesh);
+
+    mesh->vertices.len = reorder(mesh->vertices.data, mesh->vertices.len, sizeof(vec3), &mesh->faces, position);
+    mesh->normals.len = reorder(mesh->normals.data, mesh->normals.len, sizeof(vec3), &mesh->faces, normal);
+    mesh->textures.len = reorder(mesh->textures.data, mesh->textures.len, sizeof(vec2), &mesh->faces, texture);
+}
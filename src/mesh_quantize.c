@@ -0,0 +1,91 @@
+#include "mesh_quantize.h"
+
+#include <math.h>
+
+#include "macros.h"
+
+// the step between two neighbouring values when [low, high] is spread over 65536 of them. an empty range gets a step
+// of 0, so everything in it decodes to `low` exactly
+static inline float
+quantize_step(float low, float high) {
+    return (high - low) / 65535.0f;
+}
+
+static inline u16
+quantize_axis(float v, float low, float high) {
+    return high > low ? unorm16_encode((v - low) / (high - low)) : 0;
+}
+
+static void
+quantize_vertices(struct mesh *mesh) {
+    vec3 low = {0.0f, 0.0f, 0.0f}, high = low;
+    if(mesh->vertices.len > 0) {
+        low = high = mesh->vertices.data[0];
+    }
+    for(vec3 *v = mesh->vertices.data; v < vec3_array_end(&mesh->vertices); v++) {
+        low = (vec3){min(low.x, v->x), min(low.y, v->y), min(low.z, v->z)};
+        high = (vec3){max(high.x, v->x), max(high.y, v->y), max(high.z, v->z)};
+    }
+
+    vec3 step = {quantize_step(low.x, high.x), quantize_step(low.y, high.y), quantize_step(low.z, high.z)};
+    mesh->vertices_min = low;
+    mesh->vertices_scale = step;
+
+    u16vec3_array_reserve(&mesh->packed_vertices, mesh->vertices.len);
+    for(vec3 *v = mesh->vertices.data; v < vec3_array_end(&mesh->vertices); v++) {
+        u16vec3_array_push(&mesh->packed_vertices,
+                (u16vec3){
+                        quantize_axis(v->x, low.x, high.x),
+                        quantize_axis(v->y, low.y, high.y),
+                        quantize_axis(v->z, low.z, high.z),
+                });
+    }
+
+    // every vertex moves by at most half a step on each axis
+    mesh->radius += 0.5f * vec3_len(step);
+}
+
+static void
+quantize_normals(struct mesh *mesh) {
+    i16vec2_array_reserve(&mesh->packed_normals, mesh->normals.len);
+    for(vec3 *n = mesh->normals.data; n < vec3_array_end(&mesh->normals); n++) {
+        i16vec2_array_push(&mesh->packed_normals, octahedral_encode(*n));
+    }
+}
+
+static void
+quantize_textures(struct mesh *mesh) {
+    vec2 low = {0.0f, 0.0f}, high = low;
+    if(mesh->textures.len > 0) {
+        low = high = mesh->textures.data[0];
+    }
+    for(vec2 *t = mesh->textures.data; t < vec2_array_end(&mesh->textures); t++) {
+        low = (vec2){min(low.x, t->x), min(low.y, t->y)};
+        high = (vec2){max(high.x, t->x), max(high.y, t->y)};
+    }
+
+    vec2 step = {quantize_step(low.x, high.x), quantize_step(low.y, high.y)};
+    mesh->textures_min = low;
+    mesh->textures_scale = step;
+
+    u16vec2_array_reserve(&mesh->packed_textures, mesh->textures.len);
+    for(vec2 *t = mesh->textures.data; t < vec2_array_end(&mesh->textures); t++) {
+        u16vec2_array_push(&mesh->packed_textures,
+                (u16vec2){quantize_axis(t->x, low.x, high.x), quantize_axis(t->y, low.y, high.y)});
+    }
+}
+
+void
+mesh_quantize(struct mesh *mesh) {
+    quantize_vertices(mesh);
+    quantize_normals(mesh);
+    quantize_textures(mesh);
+
+    vec3_array_deinit(&mesh->vertices);
+    vec3_array_deinit(&mesh->normals);
+    vec2_array_deinit(&mesh->textures);
+    mesh->vertices = (vec3_array_t){0};
+    mesh->normals = (vec3_array_t){0};
+    mesh->textures = (vec2_array_t){0};
+    mesh->quantized = true;
+}
@@ -0,0 +1,540 @@
+#include "mesh_simplify.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "macros.h"
+
+// how much more the planes along open edges and material boundaries weigh than the faces, so those edges keep their
+// shape instead of shrinking inwards
+#define BORDER_WEIGHT 10.0
+
+// collapses are not done if they turn any of the faces around them by more than about 75 degrees
+#define MAX_FLIP_COS 0.25f
+
+// the squared distance to a set of planes, as the symmetric 4x4 matrix of the sum of `p * p^T` over the planes
+// `p = (a, b, c, d)`. `weight` is the total area the planes were weighted by
+struct quadric {
+    double a00, a01, a02, a03;
+    double a11, a12, a13;
+    double a22, a23;
+    double a33;
+    double weight;
+};
+
+static void
+quadric_add_plane(struct quadric *q, vec3 normal, float d, double weight) {
+    double a = normal.x, b = normal.y, c = normal.z;
+
+    q->a00 += weight * a * a;
+    q->a01 += weight * a * b;
+    q->a02 += weight * a * c;
+    q->a03 += weight * a * d;
+    q->a11 += weight * b * b;
+    q->a12 += weight * b * c;
+    q->a13 += weight * b * d;
+    q->a22 += weight * c * c;
+    q->a23 += weight * c * d;
+    q->a33 += weight * d * d;
+}
+
+static void
+quadric_add(struct quadric *dest, struct quadric *other) {
+    dest->a00 += other->a00;
+    dest->a01 += other->a01;
+    dest->a02 += other->a02;
+    dest->a03 += other->a03;
+    dest->a11 += other->a11;
+    dest->a12 += other->a12;
+    dest->a13 += other->a13;
+    dest->a22 += other->a22;
+    dest->a23 += other->a23;
+    dest->a33 += other->a33;
+    dest->weight += other->weight;
+}
+
+static double
+quadric_eval(struct quadric *q, vec3 p) {
+    double x = p.x, y = p.y, z = p.z;
+
+    return q->a00 * x * x + 2.0 * q->a01 * x * y + 2.0 * q->a02 * x * z + 2.0 * q->a03 * x + q->a11 * y * y +
+            2.0 * q->a12 * y * z + 2.0 * q->a13 * y + q->a22 * z * z + 2.0 * q->a23 * z + q->a33;
+}
+
+struct edge {
+    int from, to;
+    float cost;
+};
+
+define_array(struct edge, edge_array);
+
+// an edge the way it is found in the faces, to find out which ones are on a border
+struct edge_key {
+    int a, b;
+};
+
+struct edge_use {
+    int count;
+    // the range of the first face found with the edge, if another one has a different material it is a border too
+    int range;
+    bool border;
+};
+
+static inline u64
+edge_key_hash(struct edge_key *key) {
+    return hash_u64((u64)(u32)key->a << 32 | (u32)key->b);
+}
+
+static inline bool
+edge_key_equal(struct edge_key *a, struct edge_key *b) {
+    return a->a == b->a && a->b == b->b;
+}
+
+define_hash_map(struct edge_key, struct edge_use, edge_use_map, edge_key_hash, edge_key_equal);
+
+struct simplify {
+    struct mesh *mesh;
+    vec3 *positions;
+
+    // a copy of the faces of the mesh that is collapsed further and further, with the ones that collapsed marked dead
+    struct face *faces;
+    bool *dead;
+    int faces_len, live_faces;
+    // like in `mesh_optimize()`, range 0 is before the first material and range `i + 1` uses `use_materials.data[i]`
+    int *ranges;
+
+    // the planes of the faces around each vertex, and apart from those the planes along its border edges. both order
+    // the collapses, but only the faces say how far the surface moved, see `collapse_error()`
+    struct quadric *quadrics, *borders;
+
+    // rebuilt for every pass: the live faces using each vertex are `adjacency[offsets[v]]` up to
+    // `adjacency[offsets[v + 1]]`
+    int *offsets, *adjacency;
+    // the vertices that already took part in a collapse during this pass
+    bool *locked;
+    edge_array_t edges;
+
+    // the largest error of any collapse so far
+    float error;
+};
+
+static vec3
+face_normal(struct simplify *s, struct face *face) {
+    vec3 a = s->positions[face->vertices[0].vertex_index];
+    vec3 b = s->positions[face->vertices[1].vertex_index];
+    vec3 c = s->positions[face->vertices[2].vertex_index];
+
+    return vec3_cross(vec3_sub(b, a), vec3_sub(c, a));
+}
+
+static void
+simplify_init_quadrics(struct simplify *s) {
+    int vertices_len = s->mesh->vertices.len;
+    s->quadrics = alloc(max(vertices_len, 1) * sizeof(*s->quadrics));
+    s->borders = alloc(max(vertices_len, 1) * sizeof(*s->borders));
+
+    edge_use_map_t edges = {0};
+    for(int i = 0; i < s->faces_len; i++) {
+        struct face *face = &s->faces[i];
+        vec3 normal = face_normal(s, face);
+        float len = vec3_len(normal);
+        if(len == 0.0f) {
+            continue;
+        }
+        normal = vec3_scale(1.0f / len, normal);
+
+        float d = -vec3_dot(normal, s->positions[face->vertices[0].vertex_index]);
+        struct quadric q = {0};
+        quadric_add_plane(&q, normal, d, 0.5 * len);
+        q.weight = 0.5 * len;
+
+        for(int j = 0; j < 3; j++) {
+            quadric_add(&s->quadrics[face->vertices[j].vertex_index], &q);
+
+            int a = face->vertices[j].vertex_index, b = face->vertices[(j + 1) % 3].vertex_index;
+            struct edge_key key = {min(a, b), max(a, b)};
+            struct edge_use *use = edge_use_map_get(&edges, &key);
+            if(use) {
+                use->count++;
+                use->border |= use->range != s->ranges[i];
+            } else {
+                edge_use_map_put(&edges, key, (struct edge_use){1, s->ranges[i], false});
+            }
+        }
+    }
+
+    // a plane through every border edge, at a right angle to its face, keeps the vertices from sliding off the border
+    for(int i = 0; i < s->faces_len; i++) {
+        struct face *face = &s->faces[i];
+        vec3 normal = vec3_normalize(face_normal(s, face));
+
+        for(int j = 0; j < 3; j++) {
+            int a = face->vertices[j].vertex_index, b = face->vertices[(j + 1) % 3].vertex_index;
+            struct edge_use *use = edge_use_map_get(&edges, &(struct edge_key){min(a, b), max(a, b)});
+            if(!use || (use->count != 1 && !use->border)) {
+                continue;
+            }
+
+            vec3 edge = vec3_sub(s->positions[b], s->positions[a]);
+            vec3 side = vec3_cross(edge, normal);
+            float len = vec3_len(side);
+            if(len == 0.0f) {
+                continue;
+            }
+            side = vec3_scale(1.0f / len, side);
+
+            struct quadric q = {0};
+            quadric_add_plane(&q, side, -vec3_dot(side, s->positions[a]), BORDER_WEIGHT * vec3_dot(edge, edge));
+            quadric_add(&s->borders[a], &q);
+            quadric_add(&s->borders[b], &q);
+        }
+    }
+
+    edge_use_map_deinit(&edges);
+}
+
+static void
+simplify_init(struct simplify *s, struct mesh *mesh) {
+    int faces_len = mesh->faces.len, vertices_len = mesh->vertices.len;
+
+    *s = (struct simplify){
+            .mesh = mesh,
+            .positions = mesh->vertices.data,
+            .faces = alloc(faces_len * sizeof(*s->faces)),
+            .dead = alloc(faces_len * sizeof(*s->dead)),
+            .faces_len = faces_len,
+            .live_faces = faces_len,
+            .ranges = alloc(faces_len * sizeof(*s->ranges)),
+            .offsets = alloc((vertices_len + 1) * sizeof(*s->offsets)),
+            .adjacency = alloc(3 * faces_len * sizeof(*s->adjacency)),
+            .locked = alloc(max(vertices_len, 1) * sizeof(*s->locked)),
+    };
+    memcpy(s->faces, mesh->faces.data, faces_len * sizeof(*s->faces));
+
+    int range = 0;
+    for(int i = 0; i < faces_len; i++) {
+        while(range < mesh->use_materials.len && mesh->use_materials.data[range].face_index == i) {
+            range++;
+        }
+        s->ranges[i] = range;
+    }
+
+    simplify_init_quadrics(s);
+}
+
+static void
+simplify_deinit(struct simplify *s) {
+    edge_array_deinit(&s->edges);
+    free(s->locked);
+    free(s->adjacency);
+    free(s->offsets);
+    free(s->borders);
+    free(s->quadrics);
+    free(s->ranges);
+    free(s->dead);
+    free(s->faces);
+}
+
+static int
+face_corner(struct face *face, int vertex) {
+    for(int i = 0; i < 3; i++) {
+        if(face->vertices[i].vertex_index == vertex) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+// the mean squared distance of `to` from the planes of the faces around both vertices, weighted by their area
+static float
+collapse_error(struct simplify *s, int from, int to) {
+    struct quadric q = s->quadrics[from];
+    quadric_add(&q, &s->quadrics[to]);
+
+    double error = quadric_eval(&q, s->positions[to]);
+    return max(error, 0.0) / (q.weight > 0.0 ? q.weight : 1.0);
+}
+
+// the same with the border planes added on top, which is what the edges are ordered by. the border planes have no area
+// of their own, so they are divided by the area of the faces too
+static float
+collapse_cost(struct simplify *s, int from, int to) {
+    struct quadric q = s->borders[from];
+    quadric_add(&q, &s->borders[to]);
+
+    double weight = s->quadrics[from].weight + s->quadrics[to].weight;
+    double border = max(quadric_eval(&q, s->positions[to]), 0.0) / (weight > 0.0 ? weight : 1.0);
+    return collapse_error(s, from, to) + border;
+}
+
+// whether moving `from` onto `to` keeps all the faces that stay pointing about the same way
+static bool
+collapse_is_valid(struct simplify *s, int from, int to) {
+    for(int *f = &s->adjacency[s->offsets[from]]; f < &s->adjacency[s->offsets[from + 1]]; f++) {
+        struct face *face = &s->faces[*f];
+        if(s->dead[*f] || face_corner(face, to) >= 0) {
+            continue;
+        }
+
+        vec3 before = face_normal(s, face);
+        struct face moved = *face;
+        moved.vertices[face_corner(face, from)].vertex_index = to;
+        vec3 after = face_normal(s, &moved);
+
+        if(vec3_dot(before, after) <= MAX_FLIP_COS * vec3_len(before) * vec3_len(after)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// the faces that keep using `from` take over the normal and texture coordinate that `to` has in the faces that go
+// away, where they had the same ones as `from` has there. that way the attributes follow the vertex across smooth
+// surfaces, while seams and flat shaded faces keep their own
+struct attribute_move {
+    int from, to;
+};
+
+static void
+attribute_move(struct attribute_move *moves, int len, int *index) {
+    for(int i = 0; i < len; i++) {
+        if(moves[i].from == *index) {
+            *index = moves[i].to;
+            return;
+        }
+    }
+}
+
+static void
+collapse(struct simplify *s, int from, int to) {
+    s->error = max(s->error, sqrtf(collapse_error(s, from, to)));
+
+    struct attribute_move normals[8], textures[8];
+    int moves_len = 0;
+
+    int *adjacent = &s->adjacency[s->offsets[from]], *adjacent_end = &s->adjacency[s->offsets[from + 1]];
+    for(int *f = adjacent; f < adjacent_end; f++) {
+        struct face *face = &s->faces[*f];
+        int i = face_corner(face, to);
+        if(s->dead[*f] || i < 0) {
+            continue;
+        }
+
+        int j = face_corner(face, from);
+        if(moves_len < (int)(sizeof(normals) / sizeof(*normals))) {
+            normals[moves_len] =
+                    (struct attribute_move){face->vertices[j].normal_index, face->vertices[i].normal_index};
+            textures[moves_len] =
+                    (struct attribute_move){face->vertices[j].texture_index, face->vertices[i].texture_index};
+            moves_len++;
+        }
+
+        s->dead[*f] = true;
+        s->live_faces--;
+    }
+
+    for(int *f = adjacent; f < adjacent_end; f++) {
+        if(s->dead[*f]) {
+            continue;
+        }
+
+        struct vertex *vertex = &s->faces[*f].vertices[face_corner(&s->faces[*f], from)];
+        vertex->vertex_index = to;
+        attribute_move(normals, moves_len, &vertex->normal_index);
+        attribute_move(textures, moves_len, &vertex->texture_index);
+    }
+
+    quadric_add(&s->quadrics[to], &s->quadrics[from]);
+    quadric_add(&s->borders[to], &s->borders[from]);
+}
+
+static int
+edge_compare(const void *a, const void *b) {
+    float x = ((struct edge *)a)->cost, y = ((struct edge *)b)->cost;
+
+    return (x > y) - (x < y);
+}
+
+// collapses the cheapest edges, but every vertex at most once since the costs around it are out of date after that.
+// returns how many edges were collapsed
+static int
+simplify_pass(struct simplify *s, int target) {
+    int vertices_len = s->mesh->vertices.len;
+
+    memset(s->offsets, 0, (vertices_len + 1) * sizeof(*s->offsets));
+    for(int i = 0; i < s->faces_len; i++) {
+        if(s->dead[i]) {
+            continue;
+        }
+        for(int j = 0; j < 3; j++) {
+            s->offsets[s->faces[i].vertices[j].vertex_index + 1]++;
+        }
+    }
+    for(int v = 0; v < vertices_len; v++) {
+        s->offsets[v + 1] += s->offsets[v];
+    }
+    // how many of the faces of each vertex are filled in so far
+    int *filled = alloc(max(vertices_len, 1) * sizeof(*filled));
+    s->edges.len = 0;
+    for(int i = 0; i < s->faces_len; i++) {
+        if(s->dead[i]) {
+            continue;
+        }
+        for(int j = 0; j < 3; j++) {
+            int v = s->faces[i].vertices[j].vertex_index;
+            s->adjacency[s->offsets[v] + filled[v]++] = i;
+
+            // the faces on both sides of an edge add it, but the second one just finds its vertices locked
+            int a = v, b = s->faces[i].vertices[(j + 1) % 3].vertex_index;
+            float ab = collapse_cost(s, a, b), ba = collapse_cost(s, b, a);
+            edge_array_push(&s->edges, ab <= ba ? (struct edge){a, b, ab} : (struct edge){b, a, ba});
+        }
+    }
+    free(filled);
+
+    qsort(s->edges.data, s->edges.len, sizeof(*s->edges.data), edge_compare);
+
+    memset(s->locked, 0, vertices_len * sizeof(*s->locked));
+    int collapsed = 0;
+    for(struct edge *edge = s->edges.data; edge < edge_array_end(&s->edges) && s->live_faces > target; edge++) {
+        if(s->locked[edge->from] || s->locked[edge->to] || !collapse_is_valid(s, edge->from, edge->to)) {
+            continue;
+        }
+
+        collapse(s, edge->from, edge->to);
+        s->locked[edge->from] = true;
+        s->locked[edge->to] = true;
+        collapsed++;
+    }
+
+    return collapsed;
+}
+
+static void
+simplify_store_lod(struct simplify *s, struct mesh_lod *dest) {
+    *dest = (struct mesh_lod){.error = s->error};
+    face_array_reserve(&dest->faces, s->live_faces);
+
+    int range = 0;
+    for(int i = 0; i < s->faces_len; i++) {
+        if(s->dead[i]) {
+            continue;
+        }
+
+        if(s->ranges[i] != range) {
+            range = s->ranges[i];
+            struct use_material use = s->mesh->use_materials.data[range - 1];
+            use.face_index = dest->faces.len;
+            use_material_array_push(&dest->use_materials, use);
+        }
+        face_array_push(&dest->faces, s->faces[i]);
+    }
+}
+
+// the most simplified level each vertex (or normal) is used in, with `member` being the offset of its index in
+// `struct vertex`
+static void
+used_levels(struct mesh *mesh, int len, size_t member, int *dest) {
+    for(int i = 0; i < len; i++) {
+        dest[i] = 0;
+    }
+
+    for(int level = 1; level <= mesh->lods_len; level++) {
+        face_array_t *faces = &mesh->lods[level - 1].faces;
+        for(struct face *face = faces->data; face < face_array_end(faces); face++) {
+            for(int i = 0; i < 3; i++) {
+                int index = *(int *)((char *)&face->vertices[i] + member);
+                if(index >= 0) {
+                    dest[index] = level;
+                }
+            }
+        }
+    }
+}
+
+static void
+remap_faces(face_array_t *faces, size_t member, int *remap) {
+    for(struct face *face = faces->data; face < face_array_end(faces); face++) {
+        for(int i = 0; i < 3; i++) {
+            int *index = (int *)((char *)&face->vertices[i] + member);
+            if(*index >= 0) {
+                *index = remap[*index];
+            }
+        }
+    }
+}
+
+// sorts the elements from the ones used by the simplest level to the ones only the full mesh uses, keeping them in
+// the same order otherwise. `lens` gets how many of them each level uses
+static void
+sort_by_level(struct mesh *mesh, void *data, int len, size_t size, size_t member, int *lens) {
+    int *levels = alloc(max(len, 1) * sizeof(*levels));
+    int *remap = alloc(max(len, 1) * sizeof(*remap));
+    char *sorted = alloc(max(len, 1) * size);
+    used_levels(mesh, len, member, levels);
+
+    int new_len = 0;
+    for(int level = mesh->lods_len; level >= 0; level--) {
+        for(int i = 0; i < len; i++) {
+            if(levels[i] == level) {
+                memcpy(sorted + new_len * size, (char *)data + i * size, size);
+                remap[i] = new_len++;
+            }
+        }
+        lens[level] = new_len;
+    }
+    memcpy(data, sorted, len * size);
+
+    remap_faces(&mesh->faces, member, remap);
+    for(int i = 0; i < mesh->lods_len; i++) {
+        remap_faces(&mesh->lods[i].faces, member, remap);
+    }
+
+    free(sorted);
+    free(remap);
+    free(levels);
+}
+
+void
+mesh_build_lods(struct mesh *mesh) {
+    if(mesh->faces.len < 2 * MESH_LOD_MIN_FACES) {
+        return;
+    }
+
+    struct simplify s;
+    simplify_init(&s, mesh);
+
+    int len = mesh->faces.len;
+    while(mesh->lods_len < MESH_MAX_LODS && len / 2 >= MESH_LOD_MIN_FACES) {
+        int target = len / 2;
+        while(s.live_faces > target && simplify_pass(&s, target) > 0) {
+        }
+
+        // the mesh could not be simplified much further without falling apart, so this is not worth a level
+        if(s.live_faces > len * 3 / 4) {
+            break;
+        }
+
+        simplify_store_lod(&s, &mesh->lods[mesh->lods_len++]);
+        len = s.live_faces;
+    }
+
+    simplify_deinit(&s);
+
+    int lens[MESH_MAX_LODS + 1];
+    sort_by_level(mesh, mesh->vertices.data, mesh->vertices.len, sizeof(vec3), offsetof(struct vertex, vertex_index),
+            lens);
+    for(int i = 0; i < mesh->lods_len; i++) {
+        mesh->lods[i].vertices_len = lens[i + 1];
+    }
+
+    sort_by_level(mesh, mesh->normals.data, mesh->normals.len, sizeof(vec3), offsetof(struct vertex, normal_index),
+            lens);
+    for(int i = 0; i < mesh->lods_len; i++) {
+        mesh->lods[i].normals_len = lens[i + 1];
+    }
+}
@@ -1,38 +1,44 @@
 #include "render.h"
 
+#include <limits.h>
 #include <stdio.h>
+#include <string.h>
 
+#include "alloc.h"
 #include "assets.h"
 #include "box.h"
 #include "camera.h"
 #include "color.h"
+#include "command_buffer.h"
+#include "impostor.h"
 #include "macros.h"
+#include "thread_pool.h"
+#include "time_util.h"
 #include "triangle.h"
 #include "vec2.h"
 
-static float
-project_point(struct camera *camera, vec3 point, vec2 *dest) {
-    vec3 rel = vec3_sub(point, camera->pos);
-    float depth = vec3_dot(rel, camera->normal);
-
-    if(depth <= 0.0f) {
-        return depth;
-    }
-
+// the 3x4 matrix that takes a point from model space, through world and camera space, to screen coordinates before
+// the perspective divide. see `kernels->project` for how it is used
+static void
+get_projection_matrix(struct camera *camera, struct transform *transform, float dest[3][4]) {
     float f = 1.0f / tanf(camera->fov * 0.5f);
 
-    float x = vec3_dot(rel, camera->right) / depth;
-    float y = vec3_dot(rel, camera->up) / depth;
-
-    x *= f / ((float)camera->width / camera->height);
-    y *= f;
+    // x goes from (-1, 1] to (0, width], and y the same except it is also inverted so it coresponds to the buffer
+    // coordinates instead
+    vec3 rows[3] = {
+            vec3_scale(f / ((float)camera->width / camera->height) * 0.5f * camera->width, camera->right),
+            vec3_scale(-f * 0.5f * camera->height, camera->up),
+            camera->normal,
+    };
 
-    // transform it from (-1, 1] to (0, 1] and then to width x height box coords
-    dest->x = (x + 1.0f) * 0.5f * camera->width;
-    // for y we also invert it so it coresponds to the buffer coordinates instead
-    dest->y = (1.0f - (y + 1.0f) * 0.5f) * camera->height;
-
-    return depth;
+    vec3 rel = vec3_sub(transform->pos, camera->pos);
+    for(int i = 0; i < 3; i++) {
+        for(int j = 0; j < 3; j++) {
+            vec3 column = {transform->rot.m[0][j], transform->rot.m[1][j], transform->rot.m[2][j]};
+            dest[i][j] = transform->scale * vec3_dot(rows[i], column);
+        }
+        dest[i][3] = vec3_dot(rows[i], rel);
+    }
 }
 
 static inline int
@@ -40,9 +46,20 @@ camera_to_buffer_coords(struct camera *camera, int x, int y) {
     return y * camera->width + x;
 }
 
+// the vertices of a mesh after they were transformed for the node that is currently being drawn
+struct mesh_render_data {
+    struct mesh *mesh;
+
+    vec2 *screen;
+    float *depths;
+    // rotated into world space, or NULL if the mesh has none
+    vec3 *normals;
+};
+
 struct face_render_data {
     struct vertex_render_data {
-        vec3 vertex;
+        vec2 screen;
+        float depth;
         vec3 normal;
         vec2 texture;
     } vertices[3];
@@ -52,235 +69,1085 @@ struct face_render_data {
 };
 
 static void
-face_get_render_data(struct mesh *mesh, int index, struct face_render_data *dest) {
+face_get_render_data(struct mesh_render_data *data, struct face *face, struct face_render_data *dest) {
+    struct mesh *mesh = data->mesh;
+
     dest->has_normals = true;
     dest->has_textures = true;
 
-    struct face *face = &mesh->faces.data[index];
     for(int i = 0; i < 3; i++) {
         int j = face->vertices[i].vertex_index;
-        dest->vertices[i].vertex = mesh->vertices.data[j];
+        dest->vertices[i].screen = data->screen[j];
+        dest->vertices[i].depth = data->depths[j];
 
         j = face->vertices[i].normal_index;
         if(j >= 0) {
-            dest->vertices[i].normal = mesh->normals.data[j];
+            dest->vertices[i].normal = data->normals[j];
         } else {
             dest->has_normals = false;
         }
 
         j = face->vertices[i].texture_index;
         if(j >= 0) {
-            dest->vertices[i].texture = mesh->textures.data[j];
+            dest->vertices[i].texture = mesh_get_texture(mesh, j);
         } else {
             dest->has_textures = false;
         }
     }
 }
 
+static void
+triangle_setup_init(struct triangle_setup *setup, struct face_render_data *face, float area) {
+    // the barycentric coordinate of a vertex is the signed area of the triangle made by the opposite edge and the
+    // pixel, over the area of the whole triangle. since the edge goes through its first vertex we measure from there
+    for(int i = 0; i < 3; i++) {
+        vec2 a = face->vertices[(i + 1) % 3].screen;
+        vec2 b = face->vertices[(i + 2) % 3].screen;
+
+        setup->a[i] = 0.5f * (a.y - b.y) / area;
+        setup->b[i] = 0.5f * (b.x - a.x) / area;
+        setup->ox[i] = a.x;
+        setup->oy[i] = a.y;
+        setup->depths[i] = face->vertices[i].depth;
+    }
+}
+
+// the rgba bytes of the texel at the given texture coordinates
+static inline u8 *
+texture_get_texel(struct texture_level *texture, float u, float v) {
+    int x = u * (texture->width - 1);
+    // invert the y axis
+    int y = (1 - v) * (texture->height - 1);
+
+    return &texture->pixels[(y * texture->width + x) * 4];
+}
+
+#if RENDER_PROFILE
+#define profile_now() time_ticks()
+#define profile_count(ctx, counter, n) ((ctx)->stats.counter += (n))
+#else
+#define profile_now() 0
+#define profile_count(ctx, counter, n)
+#endif
+
+// everything that stays the same for the whole frame
+struct render_context {
+    struct renderer *renderer;
+    struct camera *camera;
+    u32 *buffer;
+    float *depth_buffer;
+
+    // how many times each pixel was shaded, only set for `RENDER_VIEW_OVERDRAW`
+    u16 *overdraw;
+    // only the pixels inside of it are cleared and drawn, or all of them when NULL
+    struct render_damage *damage;
+
+    // multiplies the color of whatever is being drawn, NULL when there is none
+    vec3 *tint;
+    // turns the normals of a `material->normal_map` from model to world space, while an impostor is drawn
+    mat3 *normal_map_rotation;
+
+    // where the triangles go, while the draws are being gone through
+    struct render_slice *slice;
+    // what the slices go through, either the draws of the scene or the commands that are replayed
+    struct scene_draw *draws;
+    struct render_command *commands;
+    // where the draws that were not culled go as commands, NULL unless recording
+    struct command_buffer *record;
+
+    struct render_stats stats;
+#if RENDER_PROFILE
+    u64 ticks[RENDER_STAGE_COUNT];
+#endif
+};
+
+// a face that made it through culling, with everything needed to rasterize it later on
+struct render_triangle {
+    struct face_render_data face;
+    float area;
+    struct bounding_box box;
+
+    struct material *material;
+    // same as in `struct render_context`, they point into the draws so they stay valid for the whole frame
+    vec3 *tint;
+    mat3 *normal_map_rotation;
+};
+
+define_array(struct render_triangle, render_triangle_array);
+
+define_array(struct mesh *, mesh_ptr_array);
+
+// a run of the draws of the scene, or of the commands being replayed, which is culled and transformed into triangles
+// on a thread of its own. the slices are rasterized one after the other in the order of the draws, so the image is the
+// same however many threads there are
+struct render_slice {
+    struct render_context ctx;
+    int start, end;
+
+    render_triangle_array_t triangles;
+    // meshes that should have been drawn as impostors but did not have one yet, see `render_impostor()`
+    mesh_ptr_array_t missing_impostors;
+    // the draws of the slice that were not culled, while recording
+    render_command_array_t commands;
+
+    // scratch space for the transformed vertices and normals of a single mesh
+    vec2 *screen;
+    float *depths;
+    int vertices_cap;
+    vec3 *normals;
+    int normals_cap;
+};
+
+// adds the time since `*start` to the given stage and restarts the measurement
 static inline void
-face_transform(struct face_render_data *face, struct transform *transform) {
-    vec3 pos = transform->pos;
-    float scale = transform->scale;
-    mat3 rot = transform->rot;
+profile_lap(struct render_context *ctx, enum render_stage stage, u64 *start) {
+#if RENDER_PROFILE
+    u64 now = time_ticks();
+    ctx->ticks[stage] += now - *start;
+    *start = now;
+#else
+    unused(ctx), unused(stage), unused(start);
+#endif
+}
+
+static inline u32
+shade_fragment(struct render_context *ctx, struct face_render_data *face, struct material *material,
+        struct texture_level *level, struct fragment *fragment) {
+    enum render_view view = ctx->renderer->view;
+    float alpha = fragment->alpha, beta = fragment->beta, gamma = fragment->gamma;
+
+    // white light
+    vec3 color = {1.0f, 1.0f, 1.0f};
+    vec3 normal = {0};
+    bool has_normal = face->has_normals;
+
+    if(face->has_textures && material && material->texture) {
+        // sample the texture
+        float u0 = face->vertices[0].texture.x;
+        float u1 = face->vertices[1].texture.x;
+        float u2 = face->vertices[2].texture.x;
+        float v0 = face->vertices[0].texture.y;
+        float v1 = face->vertices[1].texture.y;
+        float v2 = face->vertices[2].texture.y;
+
+        float d0 = face->vertices[0].depth, d1 = face->vertices[1].depth, d2 = face->vertices[2].depth;
+        float denom = (alpha / d0 + beta / d1 + gamma / d2);
+        if(fequal(denom, 0.0f)) {
+            // do anything
+            denom = 1.0f;
+        }
 
-    face->vertices[0].vertex = mat3_mul_vec3(rot, face->vertices[0].vertex);
-    face->vertices[1].vertex = mat3_mul_vec3(rot, face->vertices[1].vertex);
-    face->vertices[2].vertex = mat3_mul_vec3(rot, face->vertices[2].vertex);
+        float u = (alpha * u0 / d0 + beta * u1 / d1 + gamma * u2 / d2) / denom;
+        float v = (alpha * v0 / d0 + beta * v1 / d1 + gamma * v2 / d2) / denom;
+
+        u = clamp(u, 0.0f, 1.0f);
+        v = clamp(v, 0.0f, 1.0f);
+
+        u8 *texel = texture_get_texel(level, u, v);
+        if(material->alpha_test && texel[3] == 0) {
+            // see `render_triangle()`
+            return 0;
+        }
+        color.x *= texel[0] / 255.0f;
+        color.y *= texel[1] / 255.0f;
+        color.z *= texel[2] / 255.0f;
+
+        if(material->normal_map) {
+            texel = texture_get_texel(&material->normal_map->levels[0], u, v);
+            has_normal = texel[3] != 0;
+            normal = (vec3){texel[0] / 127.5f - 1.0f, texel[1] / 127.5f - 1.0f, texel[2] / 127.5f - 1.0f};
+            normal = vec3_normalize(mat3_mul_vec3(*ctx->normal_map_rotation, normal));
+        }
+    }
 
-    // also rotate the normals
     if(face->has_normals) {
-        face->vertices[0].normal = mat3_mul_vec3(rot, face->vertices[0].normal);
-        face->vertices[1].normal = mat3_mul_vec3(rot, face->vertices[1].normal);
-        face->vertices[2].normal = mat3_mul_vec3(rot, face->vertices[2].normal);
+        normal = vec3_normalize(vec3_add(
+                vec3_add(vec3_scale(alpha, face->vertices[0].normal), vec3_scale(beta, face->vertices[1].normal)),
+                vec3_scale(gamma, face->vertices[2].normal)));
     }
 
-    // and then scale and translate the positions
-    face->vertices[0].vertex = vec3_add(vec3_scale(scale, face->vertices[0].vertex), pos);
-    face->vertices[1].vertex = vec3_add(vec3_scale(scale, face->vertices[1].vertex), pos);
-    face->vertices[2].vertex = vec3_add(vec3_scale(scale, face->vertices[2].vertex), pos);
-}
+    if(view == RENDER_VIEW_NORMALS) {
+        if(!has_normal) {
+            return 0xff000000;
+        }
+        return color_pack(255, 127.5f * (normal.x + 1.0f), 127.5f * (normal.y + 1.0f), 127.5f * (normal.z + 1.0f));
+    }
 
-static inline void
-get_barycentric_coords(vec2 t[3], vec2 p, float *alpha, float *beta, float *gamma) {
-    float area = triangle_signed_area(t[0], t[1], t[2]);
+    if(!face->has_textures || !material) {
+        // just draw it in cyan
+        return 0xff00ffff;
+    }
+
+    color.x *= material->diffuse_color.x;
+    color.y *= material->diffuse_color.y;
+    color.z *= material->diffuse_color.z;
+
+    if(ctx->tint) {
+        color.x *= ctx->tint->x;
+        color.y *= ctx->tint->y;
+        color.z *= ctx->tint->z;
+    }
 
-    *alpha = triangle_signed_area(t[1], t[2], p) / area;  // bcp
-    *beta = triangle_signed_area(t[2], t[0], p) / area;  // cap
-    *gamma = triangle_signed_area(t[0], t[1], p) / area;  // abp
+    if(has_normal && view != RENDER_VIEW_ALBEDO) {
+        // vec3 light_source = vec3_scale(-1, camera->normal);
+        // vec3 light_source = {1 / sqrtf(3), 1 / sqrtf(3), 1 / sqrtf(3)};
+        vec3 light_source = {-1 / sqrtf(2), -1 / sqrtf(2), 0.0f};
+
+        float direction_factor = max(vec3_dot(normal, light_source), 0.2f);
+        color = vec3_scale(direction_factor, color);
+    }
+
+    return color_pack(255, 255 * color.x, 255 * color.y, 255 * color.z);
 }
 
-static inline vec3
-texture_get_color(struct texture *texture, float u, float v) {
-    int x = u * (texture->width - 1);
-    // invert the y axis
-    int y = (1 - v) * (texture->height - 1);
+// picks the mipmap whose texels are closest to the size of a pixel on this triangle. this is done once per triangle,
+// which is a lot cheaper than per pixel and good enough for the small triangles we mostly deal with
+static struct texture_level *
+texture_select_level(struct texture *texture, struct face_render_data *face, float area) {
+    if(texture->levels_len == 1 || !face->has_textures) {
+        return &texture->levels[0];
+    }
 
-    int index = (y * texture->width + x) * 4;
-    u8 r = texture->pixels[index];
-    u8 g = texture->pixels[index + 1];
-    u8 b = texture->pixels[index + 2];
+    vec2 t0 = face->vertices[0].texture, t1 = face->vertices[1].texture, t2 = face->vertices[2].texture;
+    float texels = fabsf(triangle_signed_area(t0, t1, t2)) * texture->width * texture->height;
 
-    return (vec3){r / 255.0f, g / 255.0f, b / 255.0f};
+    // every level has a quarter of the texels of the one before it
+    float lod = 0.5f * log2f(texels / fabsf(area));
+    int level = lod > 0.0f ? (int)lod : 0;
+
+    return &texture->levels[min(level, texture->levels_len - 1)];
 }
 
+// culls the face against the view, and otherwise adds it to the triangles of the slice
 static void
-render_face(struct face_render_data *face, struct camera *camera, struct transform *transform,
-        struct material *material, u32 *buffer, float *depth_buffer) {
-    face_transform(face, transform);
+submit_face(struct render_context *ctx, struct face_render_data *face, struct material *material) {
+    struct camera *camera = ctx->camera;
+
+    profile_count(ctx, triangles_submitted, 1);
+    u64 start = profile_now();
 
     vec2 proj[3];
-    float depths[3];
     for(int i = 0; i < 3; i++) {
-        depths[i] = project_point(camera, face->vertices[i].vertex, &proj[i]);
-        if(depths[i] <= 0.0f) {
+        if(face->vertices[i].depth <= 0.0f) {
+            // (partly) behind the camera
+            profile_count(ctx, triangles_frustum_culled, 1);
+            profile_lap(ctx, RENDER_STAGE_SETUP, &start);
             return;
         }
+        proj[i] = face->vertices[i].screen;
+    }
+
+    float area = triangle_signed_area(proj[0], proj[1], proj[2]);
+    if(area == 0.0f) {
+        profile_count(ctx, triangles_zero_area, 1);
+        profile_lap(ctx, RENDER_STAGE_SETUP, &start);
+        return;
     }
 
     // skip backfaces
-    if(triangle_signed_area(proj[0], proj[1], proj[2]) >= 0) {
+    if(area > 0.0f) {
+        profile_count(ctx, triangles_backface_culled, 1);
+        profile_lap(ctx, RENDER_STAGE_SETUP, &start);
         return;
     }
 
     struct bounding_box box = triangle_get_bounding_box(proj[0], proj[1], proj[2]);
+    int start_x = max(box.start_x, 0), end_x = min(box.end_x, camera->width);
+    int start_y = max(box.start_y, 0), end_y = min(box.end_y, camera->height);
+
+    if(start_x >= end_x || start_y >= end_y) {
+        // completely off screen
+        profile_count(ctx, triangles_frustum_culled, 1);
+        profile_lap(ctx, RENDER_STAGE_SETUP, &start);
+        return;
+    }
+
+    struct render_triangle triangle = {
+            .face = *face,
+            .area = area,
+            .box = {start_x, start_y, end_x, end_y},
+            .material = material,
+            .tint = ctx->tint,
+            .normal_map_rotation = ctx->normal_map_rotation,
+    };
+    render_triangle_array_push(&ctx->slice->triangles, triangle);
+    profile_lap(ctx, RENDER_STAGE_SETUP, &start);
+}
+
+// rasterizes the part of the triangle inside the box, which is within the bounding box of the triangle
+static void
+render_triangle(struct render_context *ctx, struct render_triangle *triangle, struct bounding_box *box) {
+    u32 *buffer = ctx->buffer;
+    float *depth_buffer = ctx->depth_buffer;
+    struct face_render_data *face = &triangle->face;
+    struct material *material = triangle->material;
+    float area = triangle->area;
+    int start_x = box->start_x, end_x = box->end_x;
+    int start_y = box->start_y, end_y = box->end_y;
+
+    ctx->tint = triangle->tint;
+    ctx->normal_map_rotation = triangle->normal_map_rotation;
+    u64 start = profile_now();
+
+    struct triangle_setup setup;
+    triangle_setup_init(&setup, face, area);
+
+    struct texture_level *level = NULL;
+    if(material && material->texture) {
+        level = texture_select_level(material->texture, face, area);
+    }
 
-    for(int x = max(box.start_x, 0); x < min(box.end_x, camera->width); x++) {
-        for(int y = max(box.start_y, 0); y < min(box.end_y, camera->height); y++) {
-            vec2 p = {x + 0.5f, y + 0.5f};
-
-            float alpha, beta, gamma;
-            get_barycentric_coords(proj, p, &alpha, &beta, &gamma);
-
-            if(alpha >= 0 && beta >= 0 && gamma >= 0) {
-                float depth = alpha * depths[0] + beta * depths[1] + gamma * depths[2];
-
-                int index = camera_to_buffer_coords(camera, x, y);
-                if(depth < depth_buffer[index]) {
-                    depth_buffer[index] = depth;
-
-                    if(face->has_textures && material) {
-                        // white light
-                        vec3 color = {1.0f, 1.0f, 1.0f};
-                        if(material->texture) {
-                            // sample the texture
-                            float u0 = face->vertices[0].texture.x;
-                            float u1 = face->vertices[1].texture.x;
-                            float u2 = face->vertices[2].texture.x;
-                            float v0 = face->vertices[0].texture.y;
-                            float v1 = face->vertices[1].texture.y;
-                            float v2 = face->vertices[2].texture.y;
-
-                            float denom = (alpha / depths[0] + beta / depths[1] + gamma / depths[2]);
-                            if(fequal(denom, 0.0f)) {
-                                // do anything
-                                denom = 1.0f;
-                            }
-
-                            float u = (alpha * u0 / depths[0] + beta * u1 / depths[1] + gamma * u2 / depths[2]) / denom;
-                            float v = (alpha * v0 / depths[0] + beta * v1 / depths[1] + gamma * v2 / depths[2]) / denom;
-
-                            u = clamp(u, 0.0f, 1.0f);
-                            v = clamp(v, 0.0f, 1.0f);
-
-                            vec3 pixel = texture_get_color(material->texture, u, v);
-                            color.x *= pixel.x;
-                            color.y *= pixel.y;
-                            color.z *= pixel.z;
-                        }
-
-                        color.x *= material->diffuse_color.x;
-                        color.y *= material->diffuse_color.y;
-                        color.z *= material->diffuse_color.z;
-
-                        if(face->has_normals) {
-                            vec3 normal = vec3_normalize(vec3_add(vec3_add(vec3_scale(alpha, face->vertices[0].normal),
-                                                                          vec3_scale(beta, face->vertices[1].normal)),
-                                    vec3_scale(gamma, face->vertices[2].normal)));
-
-                            // vec3 light_source = vec3_scale(-1, camera->normal);
-                            // vec3 light_source = {1 / sqrtf(3), 1 / sqrtf(3), 1 / sqrtf(3)};
-                            vec3 light_source = {-1 / sqrtf(2), -1 / sqrtf(2), 0.0f};
-
-                            float direction_factor = max(vec3_dot(normal, light_source), 0.2f);
-                            // printf("%f, %f, %f,    %f\n", normal.x, normal.y, normal.z, direction_factor);
-                            color = vec3_scale(direction_factor, color);
-                        }
-
-                        buffer[index] = color_pack(255, 255 * color.x, 255 * color.y, 255 * color.z);
-                    } else {
-                        // else just draw it in cyan
-                        buffer[index] = 0xff00ffff;
-                    }
-                }
+    profile_count(ctx, triangles_rasterized, 1);
+    profile_lap(ctx, RENDER_STAGE_SETUP, &start);
+
+    // first find the pixels that are inside the triangle and in front of what is already there
+    struct renderer *renderer = ctx->renderer;
+    int box_area = (end_x - start_x) * (end_y - start_y);
+    if(box_area > renderer->fragments_cap) {
+        renderer->fragments_cap = max(box_area, 2 * renderer->fragments_cap);
+        renderer->fragments = realloc(renderer->fragments, renderer->fragments_cap * sizeof(struct fragment));
+    }
+    struct fragment *fragments = renderer->fragments;
+    profile_count(ctx, pixels_tested, box_area);
+
+    int len = 0;
+    for(int y = start_y; y < end_y; y++) {
+        int row = camera_to_buffer_coords(ctx->camera, 0, y);
+        len += renderer->kernels->coverage(&setup, y, start_x, end_x, &depth_buffer[row], row, fragments + len);
+    }
+    profile_count(ctx, pixels_depth_passed, len);
+    profile_lap(ctx, RENDER_STAGE_COVERAGE, &start);
+
+    // and then shade only those. with an alpha test the depth can only be written once it is known the pixel is drawn,
+    // so anything behind the transparent parts still shows through, and only the pixels that are drawn count as shaded
+    int shaded = len;
+    if(material && material->alpha_test) {
+        shaded = 0;
+        for(struct fragment *fragment = fragments; fragment < fragments + len; fragment++) {
+            u32 color = shade_fragment(ctx, face, material, level, fragment);
+            if(color_get_alpha(color) != 0) {
+                depth_buffer[fragment->index] = fragment->depth;
+                buffer[fragment->index] = color;
+                shaded++;
             }
         }
+    } else {
+        for(struct fragment *fragment = fragments; fragment < fragments + len; fragment++) {
+            depth_buffer[fragment->index] = fragment->depth;
+            buffer[fragment->index] = shade_fragment(ctx, face, material, level, fragment);
+        }
+    }
+    if(ctx->overdraw) {
+        for(struct fragment *fragment = fragments; fragment < fragments + len; fragment++) {
+            ctx->overdraw[fragment->index]++;
+        }
     }
+    profile_count(ctx, pixels_shaded, shaded);
+    profile_lap(ctx, RENDER_STAGE_SHADING, &start);
 }
 
+// transforms all vertices and normals the level of detail uses at once, so the faces only have to look them up
 static void
-transform_add(struct transform *dest, struct transform *other) {
-    dest->pos = vec3_add(other->pos, dest->pos);
-    dest->rot = mat3_mul(other->rot, dest->rot);
-    dest->scale *= other->scale;
+mesh_transform(struct render_context *ctx, struct mesh *mesh, struct mesh_lod *lod, struct transform *transform,
+        struct mesh_render_data *dest) {
+    struct render_slice *slice = ctx->slice;
+    const struct render_kernels *kernels = ctx->renderer->kernels;
+    struct camera *camera = ctx->camera;
+    u64 start = profile_now();
+
+    int len = lod->vertices_len;
+    if(len > slice->vertices_cap) {
+        slice->vertices_cap = max(len, 2 * slice->vertices_cap);
+        slice->screen = realloc(slice->screen, slice->vertices_cap * sizeof(*slice->screen));
+        slice->depths = realloc(slice->depths, slice->vertices_cap * sizeof(*slice->depths));
+    }
+
+    float m[3][4];
+    get_projection_matrix(camera, transform, m);
+    if(mesh->quantized) {
+        // decoding is `min + packed * scale` on each axis, which the matrix can just as well do on its own
+        float low[3] = {mesh->vertices_min.x, mesh->vertices_min.y, mesh->vertices_min.z};
+        float scale[3] = {mesh->vertices_scale.x, mesh->vertices_scale.y, mesh->vertices_scale.z};
+        for(int i = 0; i < 3; i++) {
+            for(int j = 0; j < 3; j++) {
+                m[i][3] += m[i][j] * low[j];
+                m[i][j] *= scale[j];
+            }
+        }
+
+        kernels->project_packed(m, 0.5f * camera->width, 0.5f * camera->height, mesh->packed_vertices.data,
+                slice->screen, slice->depths, len);
+    } else {
+        kernels->project(m, 0.5f * camera->width, 0.5f * camera->height, mesh->vertices.data, slice->screen,
+                slice->depths, len);
+    }
+
+    // normals are only rotated, since they get normalized again when shading anyway
+    len = lod->normals_len;
+    if(len > slice->normals_cap) {
+        slice->normals_cap = max(len, 2 * slice->normals_cap);
+        slice->normals = realloc(slice->normals, slice->normals_cap * sizeof(*slice->normals));
+    }
+    if(mesh->quantized) {
+        kernels->transform_octahedral(&transform->rot, mesh->packed_normals.data, slice->normals, len);
+    } else {
+        kernels->transform(&transform->rot, mesh->normals.data, slice->normals, len);
+    }
+
+    *dest = (struct mesh_render_data){
+            .mesh = mesh,
+            .screen = slice->screen,
+            .depths = slice->depths,
+            .normals = slice->normals,
+    };
+
+    profile_lap(ctx, RENDER_STAGE_TRANSFORM, &start);
 }
 
 static void
-render_iter(struct scene_tree *tree, struct camera *camera, struct transform *transform, u32 *buffer,
-        float *depth_buffer) {
-    for(struct scene_node **node = tree->children.data; node < scene_node_ptr_array_end(&tree->children); node++) {
-        struct transform current_transform = (*node)->transform;
-        transform_add(&current_transform, transform);
-
-        switch((*node)->type) {
-            case SCENE_NODE_TYPE_MESH: {
-                struct scene_mesh *mesh = container_of((*node), struct scene_mesh, node);
-
-                struct use_material *current_material = NULL;
-                struct use_material *next_material =
-                        mesh->mesh->use_materials.len != 0 ? &mesh->mesh->use_materials.data[0] : NULL;
-
-                struct face_render_data data;
-                for(int i = 0; i < mesh->mesh->faces.len; i++) {
-                    if(next_material && next_material->face_index == i) {
-                        current_material = next_material;
-                        next_material = current_material + 1;
-                        if(next_material == use_material_array_end(&mesh->mesh->use_materials)) {
-                            next_material = NULL;
-                        }
-                    }
-
-                    face_get_render_data(mesh->mesh, i, &data);
-                    render_face(&data, camera, &current_transform, current_material->material, buffer, depth_buffer);
-                }
-                break;
+render_lod(struct render_context *ctx, struct mesh *mesh, int level, struct transform *transform) {
+    struct mesh_lod lod;
+    mesh_get_lod(mesh, level, &lod);
+
+    struct mesh_render_data data;
+    mesh_transform(ctx, mesh, &lod, transform, &data);
+
+    struct use_material *current_material = NULL;
+    struct use_material *next_material = lod.use_materials.len != 0 ? &lod.use_materials.data[0] : NULL;
+
+    struct face_render_data face;
+    for(int i = 0; i < lod.faces.len; i++) {
+        if(next_material && next_material->face_index == i) {
+            current_material = next_material;
+            next_material = current_material + 1;
+            if(next_material == use_material_array_end(&lod.use_materials)) {
+                next_material = NULL;
             }
-            case SCENE_NODE_TYPE_POLYGON: {
-                todo("implement polygon rendering");
-                break;
+        }
+
+        face_get_render_data(&data, &lod.faces.data[i], &face);
+        submit_face(ctx, &face, current_material ? current_material->material : NULL);
+    }
+}
+
+// the bounding sphere of a mesh in camera space, with x to the right, y up and z going into the screen
+struct view_sphere {
+    vec3 center;
+    float radius;
+};
+
+static void
+get_view_sphere(struct camera *camera, vec3 center, float radius, struct view_sphere *dest) {
+    vec3 rel = vec3_sub(center, camera->pos);
+
+    dest->center = (vec3){vec3_dot(camera->right, rel), vec3_dot(camera->up, rel), vec3_dot(camera->normal, rel)};
+    dest->radius = radius;
+}
+
+// whether the sphere is completely outside of the view
+static bool
+view_sphere_is_outside(struct camera *camera, struct view_sphere *sphere) {
+    float x = sphere->center.x, y = sphere->center.y, z = sphere->center.z, radius = sphere->radius;
+    if(z < -radius) {
+        return true;
+    }
+
+    // the side planes of the frustum go through the camera, at `fx * x = z` and `fy * y = z`
+    float fy = 1.0f / tanf(camera->fov * 0.5f);
+    float fx = fy / ((float)camera->width / camera->height);
+    return fx * fabsf(x) - z > radius * sqrtf(fx * fx + 1.0f) || fy * fabsf(y) - z > radius * sqrtf(fy * fy + 1.0f);
+}
+
+// the level of detail after the simplest one, which draws the impostor of the mesh instead
+static inline int
+impostor_level(struct mesh *mesh) {
+    return mesh->lods_len + 1;
+}
+
+// draws the picture of the impostor taken from closest to the camera on a quad through the center of the mesh. the
+// quad lies in the plane the picture was taken in rather than facing the camera, so it also looks right from the sides.
+//
+// the impostor is only made after the draws were gone through, so that happens on a single thread. until then the
+// simplest level of detail stands in for it
+static void
+render_impostor(struct render_context *ctx, struct mesh *mesh, struct transform *transform) {
+    if(!mesh->impostor) {
+        mesh_ptr_array_push(&ctx->slice->missing_impostors, mesh);
+        render_lod(ctx, mesh, mesh->lods_len, transform);
+        return;
+    }
+    struct impostor *impostor = mesh->impostor;
+
+    vec3 center = vec3_add(transform->pos, vec3_scale(transform->scale, mat3_mul_vec3(transform->rot, mesh->center)));
+    vec3 direction = mat3_mul_vec3(mat3_transpose(transform->rot), vec3_sub(ctx->camera->pos, center));
+    struct impostor_view *view = &impostor->views[impostor_select_view(impostor, direction)];
+
+    float size = transform->scale * impostor->half_size;
+    vec3 right = vec3_scale(size, mat3_mul_vec3(transform->rot, view->right));
+    vec3 up = vec3_scale(size, mat3_mul_vec3(transform->rot, view->up));
+
+    vec3 vertices[4] = {
+            vec3_sub(vec3_sub(center, right), up),
+            vec3_sub(vec3_add(center, right), up),
+            vec3_add(vec3_add(center, right), up),
+            vec3_add(vec3_sub(center, right), up),
+    };
+    vec2 textures[4] = {
+            view->uv_min,
+            {view->uv_max.x, view->uv_min.y},
+            view->uv_max,
+            {view->uv_min.x, view->uv_max.y},
+    };
+    struct face faces[2] = {
+            {{{0, -1, 0}, {1, -1, 1}, {2, -1, 2}}},
+            {{{0, -1, 0}, {2, -1, 2}, {3, -1, 3}}},
+    };
+    struct use_material use_material = {0, &impostor->material};
+
+    // a mesh of its own that only lives for this draw, with the vertices already in world space
+    struct mesh quad = {
+            .vertices = {4, 0, vertices},
+            .textures = {4, 0, textures},
+            .faces = {2, 0, faces},
+            .use_materials = {1, 0, &use_material},
+    };
+    struct transform identity;
+    transform_default(&identity);
+
+    ctx->normal_map_rotation = &transform->rot;
+    render_lod(ctx, &quad, 0, &identity);
+    ctx->normal_map_rotation = NULL;
+}
+
+static void
+render_mesh(struct render_context *ctx, struct mesh *mesh, int level, struct transform *transform) {
+    if(level == impostor_level(mesh)) {
+        render_impostor(ctx, mesh, transform);
+    } else {
+        render_lod(ctx, mesh, level, transform);
+    }
+}
+
+// picks the simplest level of detail whose error stays under `renderer->lod_pixels` on screen, starting from the one
+// used last time. going to a simpler level needs its error to be a good bit below that, so a mesh sitting right at the
+// threshold does not flip between two levels every frame. the impostor goes by the size of the mesh on screen instead,
+// the same way, and takes over from whichever level it would have been otherwise: its pictures are of the full mesh,
+// so how far the simplified ones are off does not matter to it
+static int
+select_lod(struct render_context *ctx, struct mesh *mesh, struct view_sphere *sphere, int level) {
+    struct camera *camera = ctx->camera;
+    float max_error = ctx->renderer->lod_pixels;
+
+    // too close to tell how big it is on screen, but at that point it is big anyway
+    if(max_error <= 0.0f || mesh->lods_len == 0 || sphere->center.z <= sphere->radius) {
+        return 0;
+    }
+
+    // how many pixels the radius of the sphere covers, and the errors of the levels are measured in the same units
+    float f = 1.0f / tanf(camera->fov * 0.5f);
+    float radius = sphere->radius * f * 0.5f * camera->height / sphere->center.z;
+    float scale = mesh->radius > 0.0f ? radius / mesh->radius : 0.0f;
+
+    float max_radius = ctx->renderer->impostor_pixels;
+    if(radius <= (level == impostor_level(mesh) ? max_radius : max_radius * RENDER_LOD_HYSTERESIS)) {
+        return impostor_level(mesh);
+    }
+
+    level = min(level, mesh->lods_len);
+    while(level > 0 && mesh->lods[level - 1].error * scale > max_error) {
+        level--;
+    }
+    while(level < mesh->lods_len && mesh->lods[level].error * scale <= max_error * RENDER_LOD_HYSTERESIS) {
+        level++;
+    }
+
+    return level;
+}
+
+// the triangles of the slice in order, only where they are inside of the damage if there is one. the boxes of the
+// damage do not overlap, so which of them goes first makes no difference
+static void
+rasterize_slice(struct render_context *ctx, struct render_slice *slice) {
+    struct render_triangle *end = render_triangle_array_end(&slice->triangles);
+    if(!ctx->damage) {
+        for(struct render_triangle *triangle = slice->triangles.data; triangle < end; triangle++) {
+            render_triangle(ctx, triangle, &triangle->box);
+        }
+        return;
+    }
+
+    for(struct box *damage = ctx->damage->boxes; damage < ctx->damage->boxes + ctx->damage->len; damage++) {
+        for(struct render_triangle *triangle = slice->triangles.data; triangle < end; triangle++) {
+            struct bounding_box box = {
+                    max(triangle->box.start_x, damage->x),
+                    max(triangle->box.start_y, damage->y),
+                    min(triangle->box.end_x, damage->x + damage->width),
+                    min(triangle->box.end_y, damage->y + damage->height),
+            };
+            if(box.start_x < box.end_x && box.start_y < box.end_y) {
+                render_triangle(ctx, triangle, &box);
+            }
+        }
+    }
+}
+
+static void
+render_draws_job(void *data, int index) {
+    struct renderer *renderer = data;
+    struct render_slice *slice = &renderer->slices[index];
+    struct render_context *ctx = &slice->ctx;
+
+    for(struct scene_draw *draw = &ctx->draws[slice->start]; draw < &ctx->draws[slice->end]; draw++) {
+        struct view_sphere sphere;
+        get_view_sphere(ctx->camera, draw->center, draw->radius, &sphere);
+        if(view_sphere_is_outside(ctx->camera, &sphere)) {
+            profile_count(ctx, triangles_submitted, draw->mesh->faces.len);
+            profile_count(ctx, triangles_frustum_culled, draw->mesh->faces.len);
+            continue;
+        }
+        draw->lod = select_lod(ctx, draw->mesh, &sphere, draw->lod);
+
+        ctx->tint = draw->tinted ? &draw->tint : NULL;
+        render_mesh(ctx, draw->mesh, draw->lod, &draw->world);
+
+        if(ctx->record) {
+            struct render_command command = {draw->mesh, draw->lod, draw->world, draw->tint, draw->tinted};
+            render_command_array_push(&slice->commands, command);
+        }
+    }
+    ctx->tint = NULL;
+}
+
+// the commands were already culled and had their level of detail picked when they were recorded, so they are only
+// transformed
+static void
+render_commands_job(void *data, int index) {
+    struct renderer *renderer = data;
+    struct render_slice *slice = &renderer->slices[index];
+    struct render_context *ctx = &slice->ctx;
+
+    for(struct render_command *command = &ctx->commands[slice->start]; command < &ctx->commands[slice->end];
+            command++) {
+        ctx->tint = command->tinted ? &command->tint : NULL;
+        render_mesh(ctx, command->mesh, command->lod, &command->transform);
+    }
+    ctx->tint = NULL;
+}
+
+// goes through `count` draws or commands in slices, on as many threads as there are, and then rasterizes the triangles
+// they were turned into
+static void
+render_slices(struct render_context *ctx, int count, job_fn_t job) {
+    struct renderer *renderer = ctx->renderer;
+
+    if(!renderer->pool && renderer->threads != 1) {
+        renderer->pool = thread_pool_create(max(renderer->threads - 1, 0));
+    }
+
+    // a few slices per thread, so a thread that got the cheap ones can take another
+    int threads = renderer->pool ? thread_pool_concurrency(renderer->pool) : 1;
+    int len = clamp(count, 1, RENDER_SLICES_PER_THREAD * threads);
+    if(len > renderer->slices_len) {
+        renderer->slices = realloc(renderer->slices, len * sizeof(*renderer->slices));
+        memset(&renderer->slices[renderer->slices_len], 0, (len - renderer->slices_len) * sizeof(*renderer->slices));
+        renderer->slices_len = len;
+    }
+
+    for(int i = 0; i < len; i++) {
+        struct render_slice *slice = &renderer->slices[i];
+        slice->ctx = *ctx;
+        slice->ctx.slice = slice;
+        slice->ctx.stats = (struct render_stats){0};
+#if RENDER_PROFILE
+        memset(slice->ctx.ticks, 0, sizeof(slice->ctx.ticks));
+#endif
+        slice->start = (long)count * i / len;
+        slice->end = (long)count * (i + 1) / len;
+        slice->triangles.len = 0;
+        slice->missing_impostors.len = 0;
+        slice->commands.len = 0;
+    }
+
+    if(renderer->pool && len > 1) {
+        struct job_group group = {0};
+        thread_pool_submit_range(renderer->pool, &group, job, renderer, len);
+        thread_pool_wait(renderer->pool, &group);
+    } else {
+        for(int i = 0; i < len; i++) {
+            job(renderer, i);
+        }
+    }
+
+    for(struct render_slice *slice = renderer->slices; slice < renderer->slices + len; slice++) {
+        render_stats_accumulate(&ctx->stats, &slice->ctx.stats);
+#if RENDER_PROFILE
+        for(int i = 0; i < RENDER_STAGE_COUNT; i++) {
+            ctx->ticks[i] += slice->ctx.ticks[i];
+        }
+#endif
+
+        rasterize_slice(ctx, slice);
+
+        if(ctx->record) {
+            for(struct render_command *command = slice->commands.data;
+                    command < render_command_array_end(&slice->commands); command++) {
+                render_command_array_push(&ctx->record->commands, *command);
             }
-            case SCENE_NODE_TYPE_TREE: {
-                tree = container_of((*node), struct scene_tree, node);
+        }
+    }
+    ctx->tint = NULL;
+    ctx->normal_map_rotation = NULL;
 
-                render_iter(tree, camera, &current_transform, buffer, depth_buffer);
-                break;
+    for(struct render_slice *slice = renderer->slices; slice < renderer->slices + len; slice++) {
+        for(struct mesh **mesh = slice->missing_impostors.data; mesh < mesh_ptr_array_end(&slice->missing_impostors);
+                mesh++) {
+            if(!(*mesh)->impostor) {
+                (*mesh)->impostor = impostor_create(*mesh);
             }
+            renderer->stale = true;
         }
     }
 }
 
+struct renderer *
+renderer_create(void) {
+    struct renderer *renderer = alloc(sizeof(*renderer));
+    renderer->view = RENDER_VIEW_SHADED;
+    renderer->kernels = kernels_get();
+
+    char *lod_pixels = getenv("RASTERIZER_LOD_PIXELS");
+    renderer->lod_pixels = lod_pixels ? atof(lod_pixels) : 1.0f;
+    char *impostor_pixels = getenv("RASTERIZER_IMPOSTOR_PIXELS");
+    renderer->impostor_pixels = impostor_pixels ? atof(impostor_pixels) : 0.5f * IMPOSTOR_TILE_SIZE;
+    char *threads = getenv("RASTERIZER_THREADS");
+    renderer->threads = threads ? atoi(threads) : 0;
+
+    return renderer;
+}
+
 void
-render(struct scene_tree *scene, struct camera *camera, u32 *buffer, float *depth_buffer) {
+renderer_destroy(struct renderer *renderer) {
+    if(renderer->pool) {
+        thread_pool_destroy(renderer->pool);
+    }
+    for(struct render_slice *slice = renderer->slices; slice < renderer->slices + renderer->slices_len; slice++) {
+        render_triangle_array_deinit(&slice->triangles);
+        mesh_ptr_array_deinit(&slice->missing_impostors);
+        render_command_array_deinit(&slice->commands);
+        free(slice->screen);
+        free(slice->depths);
+        free(slice->normals);
+    }
+    free(renderer->slices);
+
+    free(renderer->fragments);
+    free(renderer->overdraw);
+    free(renderer);
+}
+
+void
+renderer_set_view(struct renderer *renderer, enum render_view view) {
+    renderer->view = view;
+}
+
+// maps a shading count to a color going from blue, through green and yellow to red, and then white for anything that
+// was shaded more than `OVERDRAW_MAX` times
+#define OVERDRAW_MAX 8
+
+static u32
+overdraw_color(int count) {
+    static u32 colors[OVERDRAW_MAX + 2] = {
+            0xff000000,
+            0xff0000ff,
+            0xff0080ff,
+            0xff00ff80,
+            0xff00ff00,
+            0xff80ff00,
+            0xffffff00,
+            0xffff8000,
+            0xffff0000,
+            0xffffffff,
+    };
+
+    return colors[min(count, OVERDRAW_MAX + 1)];
+}
+
+static void
+resolve_overdraw(struct render_context *ctx, int start, int len) {
+    for(int i = start; i < start + len; i++) {
+        ctx->buffer[i] = overdraw_color(ctx->overdraw[i]);
+    }
+}
+
+// calls `fn` for every row of the damage, with the index of the first pixel and how many there are, or just once for
+// the whole buffer without damage
+static void
+for_each_damaged_row(struct render_context *ctx, void (*fn)(struct render_context *ctx, int start, int len)) {
+    if(!ctx->damage) {
+        fn(ctx, 0, ctx->camera->width * ctx->camera->height);
+        return;
+    }
+
+    for(struct box *box = ctx->damage->boxes; box < ctx->damage->boxes + ctx->damage->len; box++) {
+        for(int y = box->y; y < box->y + box->height; y++) {
+            fn(ctx, camera_to_buffer_coords(ctx->camera, box->x, y), box->width);
+        }
+    }
+}
+
+static void
+clear_pixels(struct render_context *ctx, int start, int len) {
+    ctx->renderer->kernels->clear(&ctx->buffer[start], &ctx->depth_buffer[start], len, 0xff87ceeb);
+    if(ctx->overdraw) {
+        memset(&ctx->overdraw[start], 0, len * sizeof(*ctx->overdraw));
+    }
+}
+
+// draws either the draws of `scene` or the given commands, whichever is not NULL
+static void
+render_frame(struct render_context *ctx, struct scene_tree *scene, struct command_buffer *commands) {
+    struct renderer *renderer = ctx->renderer;
+    struct camera *camera = ctx->camera;
+
+    u64 frame_start = profile_now();
+    u64 start = frame_start;
+    renderer->stale = false;
+
     // reset the buffers
-    for(int x = 0; x < camera->width; x++) {
-        for(int y = 0; y < camera->height; y++) {
-            buffer[y * camera->width + x] = 0xff87ceeb;
-            depth_buffer[y * camera->width + x] = INFINITY;
+    if(renderer->view == RENDER_VIEW_OVERDRAW) {
+        int len = camera->width * camera->height;
+        if(renderer->overdraw_len != len) {
+            free(renderer->overdraw);
+            renderer->overdraw = alloc(len * sizeof(*renderer->overdraw));
+            renderer->overdraw_len = len;
+        }
+        ctx->overdraw = renderer->overdraw;
+    }
+    for_each_damaged_row(ctx, clear_pixels);
+    profile_lap(ctx, RENDER_STAGE_CLEAR, &start);
+
+    if(scene) {
+        scene_update_draws(scene);
+        ctx->draws = scene->draws.data;
+        render_slices(ctx, scene->draws.len, render_draws_job);
+    } else {
+        ctx->commands = commands->commands.data;
+        render_slices(ctx, commands->commands.len, render_commands_job);
+    }
+
+#if RENDER_PROFILE
+    // the traversal is everything that is not accounted for by the per face stages. those of them that run on several
+    // threads can add up to more than the whole frame though
+    u64 faces = 0;
+    for(int i = RENDER_STAGE_TRANSFORM; i < RENDER_STAGE_COUNT; i++) {
+        faces += ctx->ticks[i];
+    }
+    u64 now = profile_now();
+    ctx->ticks[RENDER_STAGE_TRAVERSAL] = now - start > faces ? now - start - faces : 0;
+
+    for(int i = 0; i < RENDER_STAGE_COUNT; i++) {
+        ctx->stats.stage_ms[i] = time_ticks_to_ms(ctx->ticks[i]);
+    }
+    ctx->stats.frame_ms = time_ticks_to_ms(now - frame_start);
+#endif
+
+    if(ctx->overdraw) {
+        for_each_damaged_row(ctx, resolve_overdraw);
+    }
+
+    renderer->stats = ctx->stats;
+}
+
+void
+render(struct renderer *renderer, struct scene_tree *scene, struct camera *camera, u32 *buffer, float *depth_buffer) {
+    struct render_context ctx = {
+            .renderer = renderer,
+            .camera = camera,
+            .buffer = buffer,
+            .depth_buffer = depth_buffer,
+            .stats.frames = 1,
+    };
+    render_frame(&ctx, scene, NULL);
+}
+
+void
+render_damaged(struct renderer *renderer, struct scene_tree *scene, struct camera *camera, u32 *buffer,
+        float *depth_buffer, struct render_damage *damage) {
+    struct render_context ctx = {
+            .renderer = renderer,
+            .camera = camera,
+            .buffer = buffer,
+            .depth_buffer = depth_buffer,
+            .damage = damage,
+            .stats.frames = 1,
+    };
+    render_frame(&ctx, scene, NULL);
+}
+
+void
+render_record(struct renderer *renderer, struct scene_tree *scene, struct camera *camera, u32 *buffer,
+        float *depth_buffer, struct command_buffer *dest) {
+    dest->commands.len = 0;
+    dest->pos = camera->pos;
+    dest->pitch = camera->pitch;
+    dest->yaw = camera->yaw;
+    dest->fov = camera->fov;
+    dest->width = camera->width;
+    dest->height = camera->height;
+
+    struct render_context ctx = {
+            .renderer = renderer,
+            .camera = camera,
+            .buffer = buffer,
+            .depth_buffer = depth_buffer,
+            .record = dest,
+            .stats.frames = 1,
+    };
+    render_frame(&ctx, scene, NULL);
+}
+
+void
+render_commands(struct renderer *renderer, struct command_buffer *commands, struct camera *camera, u32 *buffer,
+        float *depth_buffer) {
+    struct render_context ctx = {
+            .renderer = renderer,
+            .camera = camera,
+            .buffer = buffer,
+            .depth_buffer = depth_buffer,
+            .stats.frames = 1,
+    };
+    render_frame(&ctx, NULL, commands);
+}
+
+void
+render_damage_add(struct render_damage *damage, struct box box) {
+    if(box_is_empty(&box)) {
+        return;
+    }
+
+    for(int i = 0; i < damage->len;) {
+        if(box_intersects(&damage->boxes[i], &box)) {
+            box = box_union(&damage->boxes[i], &box);
+            damage->boxes[i] = damage->boxes[--damage->len];
+            // the box grew, so it might overlap the ones before now
+            i = 0;
+        } else {
+            i++;
         }
     }
 
-    // render it with initial params
-    struct transform transform;
-    transform_default(&transform);
+    if(damage->len < RENDER_DAMAGE_MAX) {
+        damage->boxes[damage->len++] = box;
+        return;
+    }
+
+    // no room left, so it goes together with the box that grows the least from it
+    int best = 0;
+    long best_growth = LONG_MAX;
+    for(int i = 0; i < damage->len; i++) {
+        struct box merged = box_union(&damage->boxes[i], &box);
+        long growth = (long)merged.width * merged.height - (long)damage->boxes[i].width * damage->boxes[i].height;
+        if(growth < best_growth) {
+            best = i;
+            best_growth = growth;
+        }
+    }
+
+    box = box_union(&damage->boxes[best], &box);
+    damage->boxes[best] = damage->boxes[--damage->len];
+    render_damage_add(damage, box);
+}
+
+void
+render_damage_add_all(struct render_damage *dest, struct render_damage *other) {
+    for(int i = 0; i < other->len; i++) {
+        render_damage_add(dest, other->boxes[i]);
+    }
+}
+
+void
+render_damage_add_sphere(struct render_damage *damage, struct camera *camera, vec3 center, float radius) {
+    struct view_sphere sphere;
+    get_view_sphere(camera, center, radius, &sphere);
+    if(view_sphere_is_outside(camera, &sphere)) {
+        return;
+    }
+
+    struct box screen = {0, 0, camera->width, camera->height};
+    float x = sphere.center.x, y = sphere.center.y, near = sphere.center.z - radius, far = sphere.center.z + radius;
+    if(near <= 0.0f) {
+        // reaches behind the camera, so it could be anywhere on screen
+        render_damage_add(damage, screen);
+        return;
+    }
+
+    // the corners of the box around the sphere all end up in between these, see `get_projection_matrix()`. the
+    // impostors are the only thing drawn past the sphere at all, by a fraction of a pixel, and the extra pixel around
+    // it covers that
+    float f = 1.0f / tanf(camera->fov * 0.5f);
+    float fx = f / ((float)camera->width / camera->height) * 0.5f * camera->width, fy = f * 0.5f * camera->height;
+    float min_x = min((x - radius) / near, (x - radius) / far), max_x = max((x + radius) / near, (x + radius) / far);
+    float min_y = min((y - radius) / near, (y - radius) / far), max_y = max((y + radius) / near, (y + radius) / far);
+
+    int start_x = clamp(floorf(0.5f * camera->width + fx * min_x) - 1.0f, 0.0f, camera->width);
+    int end_x = clamp(ceilf(0.5f * camera->width + fx * max_x) + 1.0f, 0.0f, camera->width);
+    int start_y = clamp(floorf(0.5f * camera->height - fy * max_y) - 1.0f, 0.0f, camera->height);
+    int end_y = clamp(ceilf(0.5f * camera->height - fy * min_y) + 1.0f, 0.0f, camera->height);
+
+    render_damage_add(damage, (struct box){start_x, start_y, end_x - start_x, end_y - start_y});
+}
+
+static char *stage_names[RENDER_STAGE_COUNT] = {
+        [RENDER_STAGE_CLEAR] = "clear",
+        [RENDER_STAGE_TRAVERSAL] = "traversal",
+        [RENDER_STAGE_TRANSFORM] = "transform",
+        [RENDER_STAGE_SETUP] = "setup",
+        [RENDER_STAGE_COVERAGE] = "coverage",
+        [RENDER_STAGE_SHADING] = "shading",
+};
+
+char *
+render_stage_name(enum render_stage stage) {
+    return stage_names[stage];
+}
+
+void
+render_stats_accumulate(struct render_stats *dest, struct render_stats *other) {
+    dest->frames += other->frames;
+    dest->triangles_submitted += other->triangles_submitted;
+    dest->triangles_frustum_culled += other->triangles_frustum_culled;
+    dest->triangles_backface_culled += other->triangles_backface_culled;
+    dest->triangles_zero_area += other->triangles_zero_area;
+    dest->triangles_rasterized += other->triangles_rasterized;
+    dest->pixels_tested += other->pixels_tested;
+    dest->pixels_depth_passed += other->pixels_depth_passed;
+    dest->pixels_shaded += other->pixels_shaded;
+
+    for(int i = 0; i < RENDER_STAGE_COUNT; i++) {
+        dest->stage_ms[i] += other->stage_ms[i];
+    }
+    dest->frame_ms += other->frame_ms;
+}
+
+void
+render_stats_print(FILE *f, struct render_stats *stats) {
+    int frames = max(stats->frames, 1);
+
+    char stages[256];
+    int len = 0;
+    for(int i = 0; i < RENDER_STAGE_COUNT; i++) {
+        len += snprintf(stages + len, sizeof(stages) - len, " %s=%.3f", stage_names[i], stats->stage_ms[i] / frames);
+    }
 
-    render_iter(scene, camera, &transform, buffer, depth_buffer);
+    fprintf(f,
+            "render: %d frames, %.3f ms/frame (%s ), per frame: %llu triangles (%llu frustum culled, %llu backfaces, "
+            "%llu zero area, %llu rasterized), %llu pixels tested, %llu passed depth, %llu shaded\n",
+            stats->frames, stats->frame_ms / frames, stages, (unsigned long long)(stats->triangles_submitted / frames),
+            (unsigned long long)(stats->triangles_frustum_culled / frames),
+            (unsigned long long)(stats->triangles_backface_culled / frames),
+            (unsigned long long)(stats->triangles_zero_area / frames),
+            (unsigned long long)(stats->triangles_rasterized / frames),
+            (unsigned long long)(stats->pixels_tested / frames),
+            (unsigned long long)(stats->pixels_depth_passed / frames),
+            (unsigned long long)(stats->pixels_shaded / frames));
 }
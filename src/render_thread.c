@@ -0,0 +1,338 @@
+#include "render_thread.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "camera.h"
+#include "camera_path.h"
+#include "time_util.h"
+
+// how many finished frames we are allowed to have waiting; more than one just means drawing frames that will be
+// thrown away, since only the newest one is ever presented
+#define RENDER_AHEAD 1
+
+static bool
+should_render(struct render_thread *thread) {
+    return thread->invalidated && thread->pending_len > 0 && thread->ready_len < RENDER_AHEAD;
+}
+
+static void
+ensure_depth_buffer(struct render_thread *thread, int width, int height) {
+    if(thread->depth_buffer && thread->depth_width == width && thread->depth_height == height) {
+        return;
+    }
+
+    free(thread->depth_buffer);
+    thread->depth_buffer = alloc(width * height * sizeof(float));
+    thread->depth_width = width;
+    thread->depth_height = height;
+}
+
+// returns whether the camera is being moved by the pressed keys, in which case the next frame is going to be different
+// from this one too
+static bool
+sample_camera(struct render_thread *thread, struct camera *dest, enum render_view *view) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    float dt = thread->has_last_frame ? time_delta_ms(&now, &thread->last_frame) : 0.0f;
+    thread->last_frame = now;
+
+    // the camera is moved at the start of the frame and then copied, so the event thread can keep updating it while
+    // we are drawing
+    pthread_mutex_lock(&thread->g->lock);
+    camera_update_position(thread->g->camera, &thread->g->is_pressed, dt);
+    *dest = *thread->g->camera;
+    *view = thread->g->show_overdraw ? RENDER_VIEW_OVERDRAW : RENDER_VIEW_SHADED;
+    struct keys *pressed = &thread->g->is_pressed;
+    bool moving = pressed->w || pressed->a || pressed->s || pressed->d;
+    pthread_mutex_unlock(&thread->g->lock);
+
+    // the time spent idle does not count, or the first frame after it would jump
+    thread->has_last_frame = moving;
+
+    if(thread->g->camera_record) {
+        camera_path_record(thread->g->camera_record, dest);
+    }
+
+    return moving;
+}
+
+// whether everything but the scene is the same as in the last frame that was drawn
+static bool
+same_view(struct render_thread *thread, struct camera *camera, enum render_view view) {
+    struct camera *last = &thread->last_camera;
+
+    return thread->has_last_camera && !thread->renderer->stale && view == thread->last_view &&
+            camera->pos.x == last->pos.x && camera->pos.y == last->pos.y && camera->pos.z == last->pos.z &&
+            camera->pitch == last->pitch && camera->yaw == last->yaw && camera->fov == last->fov &&
+            camera->width == last->width && camera->height == last->height;
+}
+
+// whether the frame would look any different from the last one that was drawn
+static bool
+frame_changed(struct render_thread *thread, struct camera *camera, enum render_view view) {
+    return !same_view(thread, camera, view) || thread->g->scene->version != thread->last_version;
+}
+
+// what changed since the last frame, which is everything when anything other than the scene did
+static void
+get_frame_damage(struct render_thread *thread, struct camera *camera, enum render_view view,
+        struct render_damage *dest) {
+    struct scene_tree *scene = thread->g->scene;
+    scene_update_draws(scene);
+
+    *dest = (struct render_damage){0};
+    if(!same_view(thread, camera, view) || scene->damage_all) {
+        render_damage_add(dest, (struct box){0, 0, camera->width, camera->height});
+    } else {
+        for(struct scene_damage *damage = scene->damage.data; damage < scene_damage_array_end(&scene->damage);
+                damage++) {
+            render_damage_add_sphere(dest, camera, damage->center, damage->radius);
+        }
+    }
+    scene_clear_damage(scene);
+}
+
+// what changed since the buffer was last drawn into, i.e. the damage of every frame since then and of this one. returns
+// false when the buffer has to be drawn from scratch
+static bool
+get_buffer_damage(struct render_thread *thread, void *handle, struct render_damage *frame, struct render_damage *dest) {
+    struct render_thread_age *age = NULL, *oldest = &thread->ages[0];
+    for(struct render_thread_age *iter = thread->ages; iter < thread->ages + RENDER_THREAD_MAX_TARGETS; iter++) {
+        if(iter->handle == handle) {
+            age = iter;
+        }
+        if(iter->frame < oldest->frame) {
+            oldest = iter;
+        }
+    }
+
+    u64 since = age ? age->frame : 0;
+    if(!age) {
+        // the buffer that was drawn into the longest time ago is the one that is gone
+        age = oldest;
+        age->handle = handle;
+    }
+    age->frame = thread->frames + 1;
+
+    if(since == 0 || thread->frames - since > RENDER_THREAD_MAX_TARGETS) {
+        return false;
+    }
+
+    *dest = *frame;
+    for(u64 i = since + 1; i <= thread->frames; i++) {
+        render_damage_add_all(dest, &thread->history[i % RENDER_THREAD_MAX_TARGETS]);
+    }
+    return true;
+}
+
+static void *
+render_thread_run(void *data) {
+    struct render_thread *thread = data;
+
+    pthread_mutex_lock(&thread->mutex);
+    while(true) {
+        while(thread->running && !should_render(thread)) {
+            pthread_cond_wait(&thread->cond, &thread->mutex);
+        }
+
+        if(!thread->running) {
+            break;
+        }
+
+        thread->current = thread->pending[--thread->pending_len];
+        thread->busy = true;
+        // anything that changes from here on is picked up by the next frame
+        thread->invalidated = false;
+        pthread_mutex_unlock(&thread->mutex);
+
+        struct render_target *target = &thread->current;
+
+        struct camera camera;
+        enum render_view view;
+        bool moving = sample_camera(thread, &camera, &view);
+        // the window may be in the middle of a resize, so always draw at the size of the buffer we were given
+        camera_update_viewport(&camera, target->width, target->height);
+
+        bool changed = frame_changed(thread, &camera, view);
+        if(changed) {
+            get_frame_damage(thread, &camera, view, &target->damage);
+
+            ensure_depth_buffer(thread, target->width, target->height);
+            renderer_set_view(thread->renderer, view);
+            struct render_damage damage;
+            if(get_buffer_damage(thread, target->handle, &target->damage, &damage)) {
+                render_damaged(thread->renderer, thread->g->scene, &camera, target->data, thread->depth_buffer,
+                        &damage);
+            } else {
+                render(thread->renderer, thread->g->scene, &camera, target->data, thread->depth_buffer);
+            }
+
+            thread->frames++;
+            thread->history[thread->frames % RENDER_THREAD_MAX_TARGETS] = target->damage;
+
+            thread->last_camera = camera;
+            thread->last_view = view;
+            thread->last_version = thread->g->scene->version;
+            thread->has_last_camera = true;
+
+            if(thread->g->profile_every > 0) {
+                render_stats_accumulate(&thread->stats, &thread->renderer->stats);
+                if(thread->stats.frames >= thread->g->profile_every) {
+                    render_stats_print(stderr, &thread->stats);
+                    thread->stats = (struct render_stats){0};
+                }
+            }
+        }
+
+        pthread_mutex_lock(&thread->mutex);
+        if(changed) {
+            thread->ready[thread->ready_len++] = thread->current;
+        } else {
+            // what is on screen is still right, so the buffer was never drawn into and nothing gets presented
+            thread->pending[thread->pending_len++] = thread->current;
+        }
+        if(moving || thread->renderer->stale) {
+            thread->invalidated = true;
+        }
+        thread->busy = false;
+        pthread_cond_broadcast(&thread->cond);
+    }
+    pthread_mutex_unlock(&thread->mutex);
+
+    return NULL;
+}
+
+struct render_thread *
+render_thread_create(struct state *g) {
+    struct render_thread *thread = alloc(sizeof(*thread));
+    thread->g = g;
+    thread->renderer = renderer_create();
+    thread->running = true;
+    // there is nothing on screen yet
+    thread->invalidated = true;
+
+    pthread_mutex_init(&thread->mutex, NULL);
+    pthread_cond_init(&thread->cond, NULL);
+
+    int ret = pthread_create(&thread->thread, NULL, render_thread_run, thread);
+    assert(ret == 0);
+
+    return thread;
+}
+
+void
+render_thread_destroy(struct render_thread *thread) {
+    pthread_mutex_lock(&thread->mutex);
+    thread->running = false;
+    pthread_cond_broadcast(&thread->cond);
+    pthread_mutex_unlock(&thread->mutex);
+
+    pthread_join(thread->thread, NULL);
+
+    pthread_cond_destroy(&thread->cond);
+    pthread_mutex_destroy(&thread->mutex);
+    free(thread->depth_buffer);
+    renderer_destroy(thread->renderer);
+    free(thread);
+}
+
+void
+render_thread_invalidate(struct render_thread *thread) {
+    pthread_mutex_lock(&thread->mutex);
+    thread->invalidated = true;
+    pthread_cond_broadcast(&thread->cond);
+    pthread_mutex_unlock(&thread->mutex);
+}
+
+bool
+render_thread_is_idle(struct render_thread *thread) {
+    pthread_mutex_lock(&thread->mutex);
+    bool ret = !thread->invalidated && !thread->busy && thread->ready_len == 0;
+    pthread_mutex_unlock(&thread->mutex);
+
+    return ret;
+}
+
+static bool
+targets_contain(struct render_target *targets, int len, void *handle) {
+    for(int i = 0; i < len; i++) {
+        if(targets[i].handle == handle) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool
+render_thread_owns(struct render_thread *thread, void *handle) {
+    pthread_mutex_lock(&thread->mutex);
+    bool ret = targets_contain(thread->pending, thread->pending_len, handle) ||
+            targets_contain(thread->ready, thread->ready_len, handle) ||
+            (thread->busy && thread->current.handle == handle);
+    pthread_mutex_unlock(&thread->mutex);
+
+    return ret;
+}
+
+void
+render_thread_submit(struct render_thread *thread, struct render_target *target) {
+    pthread_mutex_lock(&thread->mutex);
+    assert(thread->pending_len < RENDER_THREAD_MAX_TARGETS);
+    thread->pending[thread->pending_len++] = *target;
+    pthread_cond_broadcast(&thread->cond);
+    pthread_mutex_unlock(&thread->mutex);
+}
+
+static void
+take_newest(struct render_thread *thread, struct render_target *dest) {
+    *dest = thread->ready[thread->ready_len - 1];
+
+    // these were never presented, so we can draw the next frames into them right away. what changed in them did not
+    // make it to the screen yet either
+    for(int i = 0; i < thread->ready_len - 1; i++) {
+        render_damage_add_all(&dest->damage, &thread->ready[i].damage);
+        thread->pending[thread->pending_len++] = thread->ready[i];
+    }
+    thread->ready_len = 0;
+
+    pthread_cond_broadcast(&thread->cond);
+}
+
+bool
+render_thread_take_ready(struct render_thread *thread, struct render_target *dest) {
+    pthread_mutex_lock(&thread->mutex);
+    bool ret = thread->ready_len > 0;
+    if(ret) {
+        take_newest(thread, dest);
+    }
+    pthread_mutex_unlock(&thread->mutex);
+
+    return ret;
+}
+
+void
+render_thread_wait_ready(struct render_thread *thread, struct render_target *dest) {
+    pthread_mutex_lock(&thread->mutex);
+    while(thread->ready_len == 0) {
+        pthread_cond_wait(&thread->cond, &thread->mutex);
+    }
+    take_newest(thread, dest);
+    pthread_mutex_unlock(&thread->mutex);
+}
+
+void
+render_thread_drain(struct render_thread *thread) {
+    pthread_mutex_lock(&thread->mutex);
+    while(thread->busy) {
+        pthread_cond_wait(&thread->cond, &thread->mutex);
+    }
+    thread->pending_len = 0;
+    thread->ready_len = 0;
+    // new buffers might end up where the old ones were
+    memset(thread->ages, 0, sizeof(thread->ages));
+    pthread_mutex_unlock(&thread->mutex);
+}
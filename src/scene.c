@@ -3,6 +3,18 @@
 #include "alloc.h"
 #include "assets.h"
 #include "macros.h"
+#include "triangulate.h"
+
+define_pool(struct scene_polygon, scene_polygon_pool);
+define_pool(struct scene_mesh, scene_mesh_pool);
+define_pool(struct scene_tree, scene_tree_pool);
+define_pool(struct scene_instances, scene_instances_pool);
+
+// shared by all scenes, and just like the scenes themselves not thread safe
+static scene_polygon_pool_t polygon_pool;
+static scene_mesh_pool_t mesh_pool;
+static scene_tree_pool_t tree_pool;
+static scene_instances_pool_t instances_pool;
 
 void
 transform_default(struct transform *dest) {
@@ -11,21 +23,235 @@ transform_default(struct transform *dest) {
     dest->scale = 1.0f;
 }
 
+void
+transform_compose(struct transform *parent, struct transform *child, struct transform *dest) {
+    dest->pos = vec3_add(parent->pos, vec3_scale(parent->scale, mat3_mul_vec3(parent->rot, child->pos)));
+    dest->rot = mat3_mul(parent->rot, child->rot);
+    dest->scale = parent->scale * child->scale;
+}
+
+// the tree without a parent the node is below, or NULL when there is none
+static struct scene_tree *
+scene_node_get_root(struct scene_node *node) {
+    while(node->parent) {
+        node = &node->parent->node;
+    }
+
+    return node->type == SCENE_NODE_TYPE_TREE ? container_of(node, struct scene_tree, node) : NULL;
+}
+
+// where the owner of the draw keeps its index
+static int *
+scene_draw_get_owner_index(struct scene_draw *draw) {
+    if(draw->node->type == SCENE_NODE_TYPE_POLYGON) {
+        struct scene_polygon *polygon = container_of(draw->node, struct scene_polygon, node);
+        return &polygon->draw_index;
+    }
+    if(draw->instance < 0) {
+        struct scene_mesh *mesh = container_of(draw->node, struct scene_mesh, node);
+        return &mesh->draw_index;
+    }
+
+    struct scene_instances *instances = container_of(draw->node, struct scene_instances, node);
+    return &instances->instances.data[draw->instance].draw_index;
+}
+
+// adds the bounds of the draw as they are now to the damage of the scene
+static void
+scene_draw_damage(struct scene_tree *root, struct scene_draw *draw) {
+    if(!draw->placed || root->damage_all) {
+        return;
+    }
+
+    if(root->damage.len == SCENE_DAMAGE_MAX) {
+        root->damage_all = true;
+        root->damage.len = 0;
+        return;
+    }
+    scene_damage_array_push(&root->damage, (struct scene_damage){draw->center, draw->radius});
+}
+
+static void
+scene_draw_add(struct scene_tree *root, struct scene_node *node, int instance) {
+    struct scene_draw draw = {
+            .dirty = true,
+            .node = node,
+            .instance = instance,
+    };
+    if(node->type == SCENE_NODE_TYPE_POLYGON) {
+        struct scene_polygon *polygon = container_of(node, struct scene_polygon, node);
+        draw.mesh = &polygon->mesh;
+    } else if(instance < 0) {
+        struct scene_mesh *mesh = container_of(node, struct scene_mesh, node);
+        draw.mesh = mesh->mesh;
+    } else {
+        struct scene_instances *instances = container_of(node, struct scene_instances, node);
+        draw.mesh = instances->mesh;
+        draw.tint = instances->instances.data[instance].tint;
+        draw.tinted = draw.tint.x != 1.0f || draw.tint.y != 1.0f || draw.tint.z != 1.0f;
+    }
+
+    scene_draw_array_push(&root->draws, draw);
+    *scene_draw_get_owner_index(scene_draw_array_last(&root->draws)) = root->draws.len - 1;
+    root->draws_dirty = true;
+    root->version++;
+}
+
+static void
+scene_draw_remove(struct scene_tree *root, int *index) {
+    scene_draw_damage(root, &root->draws.data[*index]);
+    scene_draw_array_remove_fast(&root->draws, *index);
+    if(*index < root->draws.len) {
+        *scene_draw_get_owner_index(&root->draws.data[*index]) = *index;
+    }
+    *index = -1;
+    root->version++;
+}
+
+// adds the draws of the node and everything below it to the root, or removes them from it
+static void
+scene_node_update_draws(struct scene_node *node, struct scene_tree *root, bool add) {
+    switch(node->type) {
+        case SCENE_NODE_TYPE_TREE: {
+            struct scene_tree *tree = container_of(node, struct scene_tree, node);
+            for(struct scene_node **iter = tree->children.data; iter < scene_node_ptr_array_end(&tree->children);
+                    iter++) {
+                scene_node_update_draws(*iter, root, add);
+            }
+            break;
+        }
+        case SCENE_NODE_TYPE_POLYGON: {
+            struct scene_polygon *polygon = container_of(node, struct scene_polygon, node);
+            if(add) {
+                scene_draw_add(root, node, -1);
+            } else {
+                scene_draw_remove(root, &polygon->draw_index);
+            }
+            break;
+        }
+        case SCENE_NODE_TYPE_MESH: {
+            struct scene_mesh *mesh = container_of(node, struct scene_mesh, node);
+            if(add) {
+                scene_draw_add(root, node, -1);
+            } else {
+                scene_draw_remove(root, &mesh->draw_index);
+            }
+            break;
+        }
+        case SCENE_NODE_TYPE_INSTANCES: {
+            struct scene_instances *instances = container_of(node, struct scene_instances, node);
+            for(int i = 0; i < instances->instances.len; i++) {
+                if(add) {
+                    scene_draw_add(root, node, i);
+                } else {
+                    scene_draw_remove(root, &instances->instances.data[i].draw_index);
+                }
+            }
+            break;
+        }
+    }
+}
+
+static void
+scene_node_mark_dirty_iter(struct scene_node *node, struct scene_tree *root) {
+    // everything below a dirty node is dirty already, and so are their draws
+    if(node->dirty) {
+        return;
+    }
+    node->dirty = true;
+
+    switch(node->type) {
+        case SCENE_NODE_TYPE_TREE: {
+            struct scene_tree *tree = container_of(node, struct scene_tree, node);
+            for(struct scene_node **iter = tree->children.data; iter < scene_node_ptr_array_end(&tree->children);
+                    iter++) {
+                scene_node_mark_dirty_iter(*iter, root);
+            }
+            break;
+        }
+        case SCENE_NODE_TYPE_POLYGON: {
+            struct scene_polygon *polygon = container_of(node, struct scene_polygon, node);
+            if(root) {
+                root->draws.data[polygon->draw_index].dirty = true;
+                root->draws_dirty = true;
+            }
+            break;
+        }
+        case SCENE_NODE_TYPE_MESH: {
+            struct scene_mesh *mesh = container_of(node, struct scene_mesh, node);
+            if(root) {
+                root->draws.data[mesh->draw_index].dirty = true;
+                root->draws_dirty = true;
+            }
+            break;
+        }
+        case SCENE_NODE_TYPE_INSTANCES: {
+            struct scene_instances *instances = container_of(node, struct scene_instances, node);
+            for(struct scene_instance *instance = instances->instances.data;
+                    root && instance < scene_instance_array_end(&instances->instances); instance++) {
+                root->draws.data[instance->draw_index].dirty = true;
+                root->draws_dirty = true;
+            }
+            break;
+        }
+    }
+}
+
+static void
+scene_node_mark_dirty(struct scene_node *node) {
+    struct scene_tree *root = scene_node_get_root(node);
+    scene_node_mark_dirty_iter(node, root);
+    if(root) {
+        root->version++;
+    }
+}
+
 static void
 scene_node_init(struct scene_node *node, struct scene_tree *parent, enum scene_node_type type) {
     node->parent = parent;
     node->type = type;
     transform_default(&node->transform);
+    node->dirty = true;
 
     if(parent) {
+        node->child_index = parent->children.len;
         scene_node_ptr_array_push(&parent->children, node);
+
+        struct scene_tree *root = scene_node_get_root(node);
+        if(root) {
+            scene_node_update_draws(node, root, true);
+        }
     }
 }
 
 struct scene_polygon *
 scene_add_polygon(struct scene_tree *parent, int len, vec3 vertices[len]) {
-    struct scene_polygon *scene_polygon = alloc(sizeof(*scene_polygon));
-    todo("add polygon to triangles conversion");
+    struct scene_polygon *scene_polygon = scene_polygon_pool_add(&polygon_pool);
+    scene_polygon->draw_index = -1;
+
+    // a mesh with all the vertices, a single normal and texture coordinate for all of them, and the triangles
+    struct mesh *mesh = &scene_polygon->mesh;
+    vec3_array_init(&mesh->vertices, len, vertices);
+    vec3 normal = polygon_normal(len, vertices);
+    vec3_array_init(&mesh->normals, 1, &normal);
+    vec2 texture = {0.0f, 0.0f};
+    vec2_array_init(&mesh->textures, 1, &texture);
+
+    scene_polygon->material = (struct material){.diffuse_color = {1.0f, 1.0f, 1.0f}, .opacity = 1.0f};
+    use_material_array_push(&mesh->use_materials, (struct use_material){0, &scene_polygon->material});
+
+    int (*triangles)[3] = alloc(max(len - 2, 1) * sizeof(*triangles));
+    int triangles_len = triangulate_polygon(len, vertices, normal, triangles);
+    face_array_reserve(&mesh->faces, triangles_len);
+    for(int i = 0; i < triangles_len; i++) {
+        struct face face;
+        for(int j = 0; j < 3; j++) {
+            face.vertices[j] = (struct vertex){triangles[i][j], 0, 0};
+        }
+        face_array_push(&mesh->faces, face);
+    }
+    free(triangles);
+    mesh_compute_bounds(mesh);
 
     scene_node_init(&scene_polygon->node, parent, SCENE_NODE_TYPE_POLYGON);
 
@@ -34,8 +260,9 @@ scene_add_polygon(struct scene_tree *parent, int len, vec3 vertices[len]) {
 
 struct scene_mesh *
 scene_add_mesh(struct scene_tree *parent, struct mesh *mesh) {
-    struct scene_mesh *scene_mesh = alloc(sizeof(*scene_mesh));
+    struct scene_mesh *scene_mesh = scene_mesh_pool_add(&mesh_pool);
     scene_mesh->mesh = mesh;
+    scene_mesh->draw_index = -1;
 
     scene_node_init(&scene_mesh->node, parent, SCENE_NODE_TYPE_MESH);
 
@@ -44,16 +271,27 @@ scene_add_mesh(struct scene_tree *parent, struct mesh *mesh) {
 
 struct scene_tree *
 scene_add_tree(struct scene_tree *parent) {
-    struct scene_tree *scene_tree = alloc(sizeof(*scene_tree));
+    struct scene_tree *scene_tree = scene_tree_pool_add(&tree_pool);
 
     scene_node_init(&scene_tree->node, parent, SCENE_NODE_TYPE_TREE);
 
     return scene_tree;
 }
 
+struct scene_instances *
+scene_add_instances(struct scene_tree *parent, struct mesh *mesh) {
+    struct scene_instances *scene_instances = scene_instances_pool_add(&instances_pool);
+    scene_instances->mesh = mesh;
+
+    scene_node_init(&scene_instances->node, parent, SCENE_NODE_TYPE_INSTANCES);
+
+    return scene_instances;
+}
+
 void
 scene_node_set_position(struct scene_node *node, vec3 pos) {
     node->transform.pos = pos;
+    scene_node_mark_dirty(node);
 }
 
 static inline mat3
@@ -64,33 +302,131 @@ get_rotation_matrix(vec3 rot) {
 void
 scene_node_set_rotation(struct scene_node *node, vec3 rot) {
     node->transform.rot = get_rotation_matrix(rot);
+    scene_node_mark_dirty(node);
 }
 
 void
 scene_node_set_scale(struct scene_node *node, float scale) {
     node->transform.scale = scale;
+    scene_node_mark_dirty(node);
+}
+
+int
+scene_instances_add(struct scene_instances *instances, vec3 pos, vec3 rot, float scale) {
+    struct scene_instance instance = {
+            .transform = {pos, get_rotation_matrix(rot), scale},
+            .tint = {1.0f, 1.0f, 1.0f},
+            .draw_index = -1,
+    };
+    scene_instance_array_push(&instances->instances, instance);
+
+    struct scene_tree *root = scene_node_get_root(&instances->node);
+    if(root) {
+        scene_draw_add(root, &instances->node, instances->instances.len - 1);
+    }
+
+    return instances->instances.len - 1;
+}
+
+void
+scene_instances_set_tint(struct scene_instances *instances, int index, vec3 tint) {
+    struct scene_instance *instance = &instances->instances.data[index];
+    instance->tint = tint;
+
+    struct scene_tree *root = scene_node_get_root(&instances->node);
+    if(root) {
+        struct scene_draw *draw = &root->draws.data[instance->draw_index];
+        scene_draw_damage(root, draw);
+        draw->tint = tint;
+        draw->tinted = true;
+        root->version++;
+    }
 }
 
 static void
 remove_node_from_parents_children(struct scene_node *node) {
-    for(int i = 0; i < node->parent->children.len; i++) {
-        if(node->parent->children.data[i] == node) {
-            scene_node_ptr_array_remove_fast(&node->parent->children, i);
-            return;
-        }
+    scene_node_ptr_array_t *children = &node->parent->children;
+    scene_node_ptr_array_remove_fast(children, node->child_index);
+    if(node->child_index < children->len) {
+        children->data[node->child_index]->child_index = node->child_index;
     }
 }
 
 void
 scene_node_reparent(struct scene_node *node, struct scene_tree *parent) {
+    // a tree without a parent is its own root, so its draws go too
+    struct scene_tree *root = scene_node_get_root(node);
+    if(root) {
+        scene_node_update_draws(node, root, false);
+    }
     if(node->parent) {
         remove_node_from_parents_children(node);
     }
 
     node->parent = parent;
     if(parent) {
+        node->child_index = parent->children.len;
         scene_node_ptr_array_push(&parent->children, node);
     }
+
+    root = scene_node_get_root(node);
+    if(root) {
+        scene_node_update_draws(node, root, true);
+    }
+    scene_node_mark_dirty(node);
+}
+
+struct transform *
+scene_node_get_world_transform(struct scene_node *node) {
+    if(!node->dirty) {
+        return &node->world;
+    }
+
+    if(node->parent) {
+        transform_compose(scene_node_get_world_transform(&node->parent->node), &node->transform, &node->world);
+    } else {
+        node->world = node->transform;
+    }
+    node->dirty = false;
+
+    return &node->world;
+}
+
+void
+scene_update_draws(struct scene_tree *root) {
+    if(!root->draws_dirty) {
+        return;
+    }
+
+    for(struct scene_draw *draw = root->draws.data; draw < scene_draw_array_end(&root->draws); draw++) {
+        if(!draw->dirty) {
+            continue;
+        }
+        // where it was drawn before, and then where it is drawn now
+        scene_draw_damage(root, draw);
+
+        struct transform *world = scene_node_get_world_transform(draw->node);
+        if(draw->instance < 0) {
+            draw->world = *world;
+        } else {
+            struct scene_instances *instances = container_of(draw->node, struct scene_instances, node);
+            transform_compose(world, &instances->instances.data[draw->instance].transform, &draw->world);
+        }
+
+        struct transform *t = &draw->world;
+        draw->center = vec3_add(t->pos, vec3_scale(t->scale, mat3_mul_vec3(t->rot, draw->mesh->center)));
+        draw->radius = t->scale * draw->mesh->radius;
+        draw->dirty = false;
+        draw->placed = true;
+        scene_draw_damage(root, draw);
+    }
+    root->draws_dirty = false;
+}
+
+void
+scene_clear_damage(struct scene_tree *root) {
+    root->damage.len = 0;
+    root->damage_all = false;
 }
 
 static void
@@ -103,18 +439,30 @@ scene_node_remove_iter(struct scene_node *node) {
                 scene_node_remove_iter(*iter);
             }
             scene_node_ptr_array_deinit(&tree->children);
-            free(tree);
+            scene_draw_array_deinit(&tree->draws);
+            scene_damage_array_deinit(&tree->damage);
+            scene_tree_pool_remove(&tree_pool, tree);
             break;
         }
         case SCENE_NODE_TYPE_POLYGON: {
             struct scene_polygon *polygon = container_of(node, struct scene_polygon, node);
-            todo("free the polygon struct fields");
-            free(polygon);
+            vec3_array_deinit(&polygon->mesh.vertices);
+            vec3_array_deinit(&polygon->mesh.normals);
+            vec2_array_deinit(&polygon->mesh.textures);
+            face_array_deinit(&polygon->mesh.faces);
+            use_material_array_deinit(&polygon->mesh.use_materials);
+            scene_polygon_pool_remove(&polygon_pool, polygon);
             break;
         }
         case SCENE_NODE_TYPE_MESH: {
             struct scene_mesh *mesh = container_of(node, struct scene_mesh, node);
-            free(mesh);
+            scene_mesh_pool_remove(&mesh_pool, mesh);
+            break;
+        }
+        case SCENE_NODE_TYPE_INSTANCES: {
+            struct scene_instances *instances = container_of(node, struct scene_instances, node);
+            scene_instance_array_deinit(&instances->instances);
+            scene_instances_pool_remove(&instances_pool, instances);
             break;
         }
     }
@@ -123,9 +471,62 @@ scene_node_remove_iter(struct scene_node *node) {
 void
 scene_node_remove(struct scene_node *node) {
     if(node->parent) {
+        struct scene_tree *root = scene_node_get_root(node);
+        if(root) {
+            scene_node_update_draws(node, root, false);
+        }
         remove_node_from_parents_children(node);
     }
 
     // this will remove the object nodes, and iteratively remove the tree's children and childrens children etc
     scene_node_remove_iter(node);
 }
+
+struct scene_handle
+scene_node_get_handle(struct scene_node *node) {
+    struct scene_handle handle = {.type = node->type};
+    switch(node->type) {
+        case SCENE_NODE_TYPE_MESH: {
+            handle.pool = scene_mesh_pool_handle(container_of(node, struct scene_mesh, node));
+            break;
+        }
+        case SCENE_NODE_TYPE_POLYGON: {
+            handle.pool = scene_polygon_pool_handle(container_of(node, struct scene_polygon, node));
+            break;
+        }
+        case SCENE_NODE_TYPE_TREE: {
+            handle.pool = scene_tree_pool_handle(container_of(node, struct scene_tree, node));
+            break;
+        }
+        case SCENE_NODE_TYPE_INSTANCES: {
+            handle.pool = scene_instances_pool_handle(container_of(node, struct scene_instances, node));
+            break;
+        }
+    }
+
+    return handle;
+}
+
+struct scene_node *
+scene_node_from_handle(struct scene_handle handle) {
+    switch(handle.type) {
+        case SCENE_NODE_TYPE_MESH: {
+            struct scene_mesh *mesh = scene_mesh_pool_get(&mesh_pool, handle.pool);
+            return mesh ? &mesh->node : NULL;
+        }
+        case SCENE_NODE_TYPE_POLYGON: {
+            struct scene_polygon *polygon = scene_polygon_pool_get(&polygon_pool, handle.pool);
+            return polygon ? &polygon->node : NULL;
+        }
+        case SCENE_NODE_TYPE_TREE: {
+            struct scene_tree *tree = scene_tree_pool_get(&tree_pool, handle.pool);
+            return tree ? &tree->node : NULL;
+        }
+        case SCENE_NODE_TYPE_INSTANCES: {
+            struct scene_instances *instances = scene_instances_pool_get(&instances_pool, handle.pool);
+            return instances ? &instances->node : NULL;
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,196 @@
+#include "scenes.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "macros.h"
+
+#define LEN(array) (sizeof(array) / sizeof((array)[0]))
+
+// loads all the meshes in parallel, returns false if any of them failed
+static bool
+load_meshes(struct assets_manager *assets, char **paths, int len, struct mesh **dest) {
+    struct mesh_future *futures[len];
+    for(int i = 0; i < len; i++) {
+        futures[i] = assets_manager_load_mesh_async(assets, paths[i]);
+    }
+
+    bool ret = true;
+    for(int i = 0; i < len; i++) {
+        dest[i] = mesh_future_wait(futures[i]);
+        ret = ret && dest[i];
+    }
+
+    return ret;
+}
+
+static bool
+load_demo(struct scene_tree *scene, struct assets_manager *assets, struct camera *camera) {
+    char *paths[] = {
+            "assets/meshes/mon_ronera.obj",
+            "assets/meshes/sofa.obj",
+            "assets/meshes/tree.obj",
+            "assets/meshes/Grass_Block.obj",
+            "assets/meshes/healer.obj",
+    };
+
+    struct mesh *meshes[LEN(paths)];
+    if(!load_meshes(assets, paths, LEN(paths), meshes)) {
+        return false;
+    }
+
+    for(size_t i = 0; i < LEN(paths); i++) {
+        struct scene_mesh *scene_mesh = scene_add_mesh(scene, meshes[i]);
+        if(i == 0) {
+            scene_node_set_scale(&scene_mesh->node, 5.0f);
+        } else if(i == 1) {
+            scene_node_set_scale(&scene_mesh->node, 100.0f);
+        } else if(i == 3) {
+            scene_node_set_scale(&scene_mesh->node, 100.0f);
+        } else {
+            scene_node_set_scale(&scene_mesh->node, 10.0f);
+        }
+        // meshes usually assume opengl conventions so we flip them
+        scene_node_set_rotation(&scene_mesh->node, (vec3){M_PI_2, 0.0f, 0.0f});
+        scene_node_set_position(&scene_mesh->node, (vec3){i * 500.0f, 0.0f, 0.0f});
+    }
+
+    camera->pos = (vec3){0.0f, -1000.0f, 0.0f};
+
+    return true;
+}
+
+// places a mesh standing upright on the ground plane
+static struct scene_mesh *
+add_upright(struct scene_tree *scene, struct mesh *mesh, vec3 pos, float scale, float yaw) {
+    struct scene_mesh *scene_mesh = scene_add_mesh(scene, mesh);
+    scene_node_set_scale(&scene_mesh->node, scale);
+    scene_node_set_rotation(&scene_mesh->node, (vec3){M_PI_2, 0.0f, yaw});
+    scene_node_set_position(&scene_mesh->node, pos);
+
+    return scene_mesh;
+}
+
+// a grid of trees on grass, lots of small instanced meshes with little overdraw each
+static bool
+load_forest(struct scene_tree *scene, struct assets_manager *assets, struct camera *camera) {
+    char *paths[] = {"assets/meshes/tree.obj", "assets/meshes/Grass_Block.obj"};
+    struct mesh *meshes[LEN(paths)];
+    if(!load_meshes(assets, paths, LEN(paths), meshes)) {
+        return false;
+    }
+    struct mesh *tree = meshes[0], *grass = meshes[1];
+
+    struct scene_instances *grass_blocks = scene_add_instances(scene, grass);
+    struct scene_instances *trees = scene_add_instances(scene, tree);
+    for(int x = 0; x < 16; x++) {
+        for(int y = 0; y < 16; y++) {
+            vec3 pos = {x * 400.0f, y * 400.0f, 0.0f};
+            scene_instances_add(grass_blocks, (vec3){pos.x, pos.y, -200.0f}, (vec3){M_PI_2, 0.0f, 0.0f}, 100.0f);
+            // vary the rotation a bit so it does not look too regular
+            scene_instances_add(trees, pos, (vec3){M_PI_2, 0.0f, (x * 7 + y * 13) % 8 * (M_PI / 4.0f)}, 10.0f);
+        }
+    }
+
+    camera->pos = (vec3){-1000.0f, -1000.0f, 600.0f};
+
+    return true;
+}
+
+// a handful of low poly buildings and props, with multiple materials each
+static bool
+load_village(struct scene_tree *scene, struct assets_manager *assets, struct camera *camera) {
+    char *paths[] = {
+            "assets/meshes/tower-square-top-b.obj",
+            "assets/meshes/roof-edge.obj",
+            "assets/meshes/weapon-catapult.obj",
+    };
+    struct mesh *meshes[LEN(paths)];
+    if(!load_meshes(assets, paths, LEN(paths), meshes)) {
+        return false;
+    }
+    struct mesh *tower = meshes[0], *roof = meshes[1], *catapult = meshes[2];
+
+    for(int i = 0; i < 8; i++) {
+        float angle = i * (2.0f * M_PI / 8.0f);
+        vec3 pos = {cosf(angle) * 1200.0f, sinf(angle) * 1200.0f, 0.0f};
+        add_upright(scene, tower, pos, 400.0f, angle);
+        add_upright(scene, roof, vec3_scale(0.6f, pos), 300.0f, angle);
+        add_upright(scene, catapult, vec3_scale(0.3f, pos), 500.0f, angle);
+    }
+
+    camera->pos = (vec3){0.0f, -2500.0f, 800.0f};
+
+    return true;
+}
+
+// a single dense mesh filling most of the screen, mostly measures raw fill rate
+static bool
+load_statue(struct scene_tree *scene, struct assets_manager *assets, struct camera *camera) {
+    struct mesh *mesh = assets_manager_load_mesh(assets, "assets/meshes/mon_ronera.obj");
+    if(!mesh) {
+        return false;
+    }
+
+    add_upright(scene, mesh, (vec3){0}, 5.0f, 0.0f);
+    camera->pos = (vec3){0.0f, -700.0f, 450.0f};
+
+    return true;
+}
+
+// a few flat polygons side by side facing the camera, concave ones included, with no meshes to load at all
+static bool
+load_shapes(struct scene_tree *scene, struct assets_manager *assets, struct camera *camera) {
+    unused(assets);
+
+    // in the xz plane, counter clockwise as seen from the camera
+    vec3 square[] = {{-100.0f, 0.0f, -100.0f}, {100.0f, 0.0f, -100.0f}, {100.0f, 0.0f, 100.0f}, {-100.0f, 0.0f, 100.0f}};
+    vec3 l_shape[] = {
+            {-100.0f, 0.0f, -100.0f},
+            {100.0f, 0.0f, -100.0f},
+            {100.0f, 0.0f, -20.0f},
+            {-20.0f, 0.0f, -20.0f},
+            {-20.0f, 0.0f, 100.0f},
+            {-100.0f, 0.0f, 100.0f},
+    };
+    vec3 star[10];
+    for(int i = 0; i < 10; i++) {
+        float angle = M_PI_2 + i * (M_PI / 5.0f), radius = i % 2 == 0 ? 110.0f : 45.0f;
+        star[i] = (vec3){radius * cosf(angle), 0.0f, radius * sinf(angle)};
+    }
+
+    struct {
+        int len;
+        vec3 *vertices;
+    } shapes[] = {{LEN(square), square}, {LEN(l_shape), l_shape}, {LEN(star), star}};
+    for(size_t i = 0; i < LEN(shapes); i++) {
+        struct scene_polygon *polygon = scene_add_polygon(scene, shapes[i].len, shapes[i].vertices);
+        scene_node_set_position(&polygon->node, (vec3){(i - 1.0f) * 250.0f, 0.0f, 0.0f});
+    }
+
+    camera->pos = (vec3){0.0f, -600.0f, 0.0f};
+
+    return true;
+}
+
+static struct {
+    char *name;
+    bool (*load)(struct scene_tree *scene, struct assets_manager *assets, struct camera *camera);
+} scenes[] = {
+        {"demo", load_demo},
+        {"forest", load_forest},
+        {"village", load_village},
+        {"statue", load_statue},
+        {"shapes", load_shapes},
+};
+
+bool
+scenes_load(char *name, struct scene_tree *scene, struct assets_manager *assets, struct camera *camera) {
+    for(size_t i = 0; i < LEN(scenes); i++) {
+        if(strcmp(scenes[i].name, name) == 0) {
+            return scenes[i].load(scene, assets, camera);
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,143 @@
+#include "thread_pool.h"
+
+#include <unistd.h>
+
+#include "alloc.h"
+
+// pops the oldest job, the mutex has to be held
+static bool
+take_job(struct thread_pool *pool, struct job *dest) {
+    if(pool->head == pool->jobs.len) {
+        return false;
+    }
+
+    *dest = pool->jobs.data[pool->head++];
+    if(pool->head == pool->jobs.len) {
+        // empty again, so start from the beginning instead of growing forever
+        pool->head = 0;
+        pool->jobs.len = 0;
+    }
+
+    return true;
+}
+
+// runs the job without the mutex held and then marks it finished
+static void
+run_job(struct thread_pool *pool, struct job *job) {
+    pthread_mutex_unlock(&pool->mutex);
+    job->fn(job->data, job->index);
+    pthread_mutex_lock(&pool->mutex);
+
+    job->group->pending--;
+    if(job->group->pending == 0) {
+        pthread_cond_broadcast(&pool->done);
+    }
+}
+
+static void *
+thread_pool_worker(void *data) {
+    struct thread_pool *pool = data;
+
+    pthread_mutex_lock(&pool->mutex);
+    while(true) {
+        struct job job;
+        if(take_job(pool, &job)) {
+            run_job(pool, &job);
+            continue;
+        }
+
+        if(!pool->running) {
+            break;
+        }
+
+        pthread_cond_wait(&pool->has_jobs, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return NULL;
+}
+
+struct thread_pool *
+thread_pool_create(int threads) {
+    if(threads <= 0) {
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+        // the thread that waits helps out, so one less is enough to keep all of them busy
+        threads = threads > 1 ? threads - 1 : 0;
+    }
+
+    struct thread_pool *pool = alloc(sizeof(*pool));
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->has_jobs, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->running = true;
+
+    pool->threads = alloc((threads > 0 ? threads : 1) * sizeof(*pool->threads));
+    for(int i = 0; i < threads; i++) {
+        if(pthread_create(&pool->threads[i], NULL, thread_pool_worker, pool) != 0) {
+            break;
+        }
+        pool->threads_len++;
+    }
+
+    return pool;
+}
+
+void
+thread_pool_destroy(struct thread_pool *pool) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->running = false;
+    pthread_cond_broadcast(&pool->has_jobs);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for(int i = 0; i < pool->threads_len; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    job_array_deinit(&pool->jobs);
+    free(pool->threads);
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->has_jobs);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool);
+}
+
+void
+thread_pool_submit(struct thread_pool *pool, struct job_group *group, job_fn_t fn, void *data, int index) {
+    pthread_mutex_lock(&pool->mutex);
+    job_array_push(&pool->jobs, (struct job){fn, data, index, group});
+    group->pending++;
+    pthread_cond_signal(&pool->has_jobs);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void
+thread_pool_submit_range(struct thread_pool *pool, struct job_group *group, job_fn_t fn, void *data, int count) {
+    pthread_mutex_lock(&pool->mutex);
+    job_array_reserve(&pool->jobs, pool->jobs.len + count);
+    for(int i = 0; i < count; i++) {
+        job_array_push(&pool->jobs, (struct job){fn, data, i, group});
+    }
+    group->pending += count;
+    pthread_cond_broadcast(&pool->has_jobs);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void
+thread_pool_wait(struct thread_pool *pool, struct job_group *group) {
+    pthread_mutex_lock(&pool->mutex);
+    while(group->pending > 0) {
+        struct job job;
+        if(take_job(pool, &job)) {
+            run_job(pool, &job);
+        } else {
+            // everything left of this group is already running on other threads
+            pthread_cond_wait(&pool->done, &pool->mutex);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+int
+thread_pool_concurrency(struct thread_pool *pool) {
+    return pool->threads_len + 1;
+}
@@ -0,0 +1,28 @@
+#include "time_util.h"
+
+#if TIME_HAS_TSC
+#include <pthread.h>
+
+static pthread_once_t calibrate_once = PTHREAD_ONCE_INIT;
+static double ticks_per_ms;
+
+// busy-waits for 10 ms, so it is only done once no matter how many threads ask at the same time
+static void
+calibrate(void) {
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    uint64_t ticks = __rdtsc();
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while(time_delta_ms(&now, &start) < 10.0);
+
+    ticks_per_ms = (__rdtsc() - ticks) / time_delta_ms(&now, &start);
+}
+
+double
+time_ticks_per_ms(void) {
+    pthread_once(&calibrate_once, calibrate);
+
+    return ticks_per_ms;
+}
+#endif
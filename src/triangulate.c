@@ -0,0 +1,125 @@
+#include "triangulate.h"
+
+#include <math.h>
+#include <stdbool.h>
+
+#include "alloc.h"
+#include "vec2.h"
+
+vec3
+polygon_normal(int len, vec3 vertices[len]) {
+    vec3 normal = {0};
+    for(int i = 0; i < len; i++) {
+        vec3 a = vertices[i], b = vertices[(i + 1) % len];
+        normal.x += (a.y - b.y) * (a.z + b.z);
+        normal.y += (a.z - b.z) * (a.x + b.x);
+        normal.z += (a.x - b.x) * (a.y + b.y);
+    }
+
+    return vec3_len(normal) > 0.0f ? vec3_normalize(normal) : normal;
+}
+
+// twice the area of the triangle, positive when it goes around counter clockwise
+static inline float
+signed_area(vec2 a, vec2 b, vec2 c) {
+    vec2 ab = vec2_sub(b, a), ac = vec2_sub(c, a);
+
+    return ab.x * ac.y - ab.y * ac.x;
+}
+
+static inline bool
+triangle_contains(vec2 a, vec2 b, vec2 c, vec2 p) {
+    return signed_area(a, b, p) >= 0.0f && signed_area(b, c, p) >= 0.0f && signed_area(c, a, p) >= 0.0f;
+}
+
+// whether the corner at `b` can be cut off: it has to point outwards, and no other vertex may lie in the triangle. a
+// vertex at the same place as one of the corners does not count, those come from polygons that touch themselves
+static bool
+is_ear(vec2 *points, int *next, int a, int b, int c) {
+    if(signed_area(points[a], points[b], points[c]) <= 0.0f) {
+        return false;
+    }
+
+    for(int i = next[c]; i != a; i = next[i]) {
+        vec2 p = points[i];
+        bool is_corner = (p.x == points[a].x && p.y == points[a].y) || (p.x == points[b].x && p.y == points[b].y) ||
+                (p.x == points[c].x && p.y == points[c].y);
+        if(!is_corner && triangle_contains(points[a], points[b], points[c], p)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int
+triangulate_polygon(int len, vec3 vertices[len], vec3 normal, int dest[][3]) {
+    if(len < 3) {
+        return 0;
+    }
+
+    // drops the axis the normal is closest to, and mirrors the rest so the polygon goes around counter clockwise
+    vec3 n = {fabsf(normal.x), fabsf(normal.y), fabsf(normal.z)};
+    int axis = 2;
+    if(n.x > n.y && n.x > n.z) {
+        axis = 0;
+    } else if(n.y > n.z) {
+        axis = 1;
+    }
+    float side = (axis == 0 ? normal.x : axis == 1 ? normal.y : normal.z) < 0.0f ? -1.0f : 1.0f;
+
+    vec2 *points = alloc(len * sizeof(*points));
+    int *prev = alloc(len * sizeof(*prev)), *next = alloc(len * sizeof(*next));
+    for(int i = 0; i < len; i++) {
+        vec3 v = vertices[i];
+        switch(axis) {
+            case 0: {
+                points[i] = (vec2){v.y, side * v.z};
+                break;
+            }
+            case 1: {
+                points[i] = (vec2){v.z, side * v.x};
+                break;
+            }
+            default: {
+                points[i] = (vec2){v.x, side * v.y};
+                break;
+            }
+        }
+        prev[i] = (i + len - 1) % len;
+        next[i] = (i + 1) % len;
+    }
+
+    int triangles = 0, remaining = len, current = 0, misses = 0;
+    while(remaining > 3) {
+        int a = prev[current], b = current, c = next[current];
+
+        // once every corner was tried without finding an ear, the polygon is not simple, or only has ears without any
+        // area left. cutting off the corner anyway still makes progress
+        if(is_ear(points, next, a, b, c) || misses >= remaining) {
+            dest[triangles][0] = a;
+            dest[triangles][1] = b;
+            dest[triangles][2] = c;
+            triangles++;
+
+            next[a] = c;
+            prev[c] = a;
+            remaining--;
+            misses = 0;
+            current = c;
+        } else {
+            misses++;
+            current = c;
+        }
+    }
+    dest[triangles][0] = prev[current];
+    dest[triangles][1] = current;
+    dest[triangles][2] = next[current];
+    triangles++;
+
+    free(next);
+    free(prev);
+    free(points);
+
+    return triangles;
+}
@@ -7,7 +7,7 @@
 #include "camera.h"
 #include "ints.h"
 #include "macros.h"
-#include "render.h"
+#include "render_thread.h"
 #include "w_desktop_shell.h"
 #include "w_keyboard.h"
 #include "w_pointer.h"
@@ -26,7 +26,11 @@ pointer_handle_relative_motion(struct w_pointer* pointer, struct w_surface* surf
     unused(surface), unused(dx_unaccel), unused(dy_unaccel);
 
     struct window* window = pointer->data;
+    pthread_mutex_lock(&window->g->lock);
     camera_update_orientation(window->g->camera, dx, dy);
+    pthread_mutex_unlock(&window->g->lock);
+
+    window_invalidate(window);
 }
 
 static struct w_pointer_listener pointer_listener = {
@@ -40,6 +44,8 @@ keyboard_handle_key(struct w_keyboard* keyboard, struct w_surface* surface, u32
 
     struct window* window = keyboard->data;
 
+    // the pressed keys are sampled by the render thread at the start of each frame
+    pthread_mutex_lock(&window->g->lock);
     switch(raw) {
         case KEY_W: {
             window->g->is_pressed.w = !!state;
@@ -69,7 +75,18 @@ keyboard_handle_key(struct w_keyboard* keyboard, struct w_surface* surface, u32
             }
             break;
         }
+        case KEY_O: {
+            // switch between the normal image and the overdraw heatmap
+            if(state) {
+                window->g->show_overdraw = !window->g->show_overdraw;
+            }
+            break;
+        }
     }
+    pthread_mutex_unlock(&window->g->lock);
+
+    // releasing a key stops the camera, which the render thread notices on its own, but pressing one has to wake it
+    window_invalidate(window);
 }
 
 static struct w_keyboard_listener keyboard_listener = {
@@ -77,44 +94,78 @@ static struct w_keyboard_listener keyboard_listener = {
 };
 
 static void
-render_frame(struct window* window, float dt);
-
-static void
-handle_frame(struct w_surface* surface, float dt) {
-    unused(dt), unused(surface);
-
-    struct window* window = surface->data;
-    render_frame(window, dt);
-}
+handle_frame(struct w_surface* surface, float dt);
 
 static void
-render_frame(struct window* window, float dt) {
+ensure_buffer_pool(struct window* window) {
+    pthread_mutex_lock(&window->g->lock);
     int width = window->g->camera->width;
     int height = window->g->camera->height;
+    pthread_mutex_unlock(&window->g->lock);
 
     if(!window->buffer_pool) {
-        window->buffer_pool = w_buffer_pool_create(window->g->conn, width, height, 3);
+        window->buffer_pool = w_buffer_pool_create(window->g->conn, width, height, WINDOW_BUFFER_COUNT);
     } else if(width != window->buffer_pool->width || height != window->buffer_pool->height) {
+        // the render thread may still be drawing into one of the old buffers, so wait for it before destroying them
+        render_thread_drain(window->render_thread);
         w_buffer_pool_destroy(window->buffer_pool);
-        window->buffer_pool = w_buffer_pool_create(window->g->conn, width, height, 3);
+        window->buffer_pool = w_buffer_pool_create(window->g->conn, width, height, WINDOW_BUFFER_COUNT);
     }
+}
 
+// hands the buffer the pool gives out next to the render thread, unless it already has it. the pool always gives out
+// the first buffer the compositor is not using, and it does not know about the render thread, so as long as that one
+// is still held there the others cannot be reached. that makes it at most one new buffer per call, and the rest follow
+// one frame at a time as the held ones get presented
+static void
+submit_free_buffer(struct window* window) {
     struct w_buffer* buffer = w_buffer_pool_get_buffer(window->buffer_pool);
-    if(!buffer) {
+    if(!buffer || render_thread_owns(window->render_thread, buffer)) {
         return;
     }
 
-    camera_update_position(window->g->camera, &window->g->is_pressed, dt);
+    struct render_target target = {
+            .handle = buffer,
+            .data = buffer->data,
+            .width = window->buffer_pool->width,
+            .height = window->buffer_pool->height,
+    };
+    render_thread_submit(window->render_thread, &target);
+}
 
-    // create a new depth buffer if needed
-    if(!window->g->depth_buffer) {
-        window->g->depth_buffer = alloc(window->g->camera->width * window->g->camera->height * sizeof(float));
+static void
+present(struct window* window, struct render_target* target) {
+    struct w_surface* surface = window->toplevel->surface;
+    w_surface_set_buffer(surface, target->handle);
+
+    // only what changed since the last buffer that was presented, so the compositor does not have to redo the rest
+    for(struct box* box = target->damage.boxes; box < target->damage.boxes + target->damage.len; box++) {
+        wl_surface_damage_buffer(surface->wl_surface, box->x, box->y, box->width, box->height);
     }
+    w_surface_commit(surface);
+}
 
-    render(window->g->scene, window->g->camera, buffer->data, window->g->depth_buffer);
+static void
+handle_frame(struct w_surface* surface, float dt) {
+    unused(dt);
+
+    struct window* window = surface->data;
+    ensure_buffer_pool(window);
+
+    // the frames are drawn ahead on the render thread, so all that is left here is to show the newest one, if it is
+    // done. if it is not we just try again on the next frame instead of blocking the event loop
+    struct render_target target;
+    if(render_thread_take_ready(window->render_thread, &target)) {
+        present(window, &target);
+    }
 
-    w_surface_set_buffer(window->toplevel->surface, buffer);
-    w_surface_commit(window->toplevel->surface);
+    submit_free_buffer(window);
+
+    // nothing changed since the last frame that was presented, so stop asking for frames until something does
+    if(render_thread_is_idle(window->render_thread)) {
+        window->idle = true;
+        return;
+    }
 
     w_surface_request_frame(window->surface, handle_frame);
 }
@@ -123,19 +174,34 @@ static void
 handle_configure(struct w_toplevel* toplevel) {
     struct window* window = toplevel->data;
 
-    if(toplevel->current.width != window->g->camera->width || toplevel->current.height != window->g->camera->height) {
+    // note: we dont recreate the buffers right away since the window may be resizing, resulting in a lot of configures
+    // in a short amount of time (before the next frame needs to be drawn). for the same reason we only draw the
+    // initial frame here, and refer to the frame events othwerwise.
+    pthread_mutex_lock(&window->g->lock);
+    bool resized = toplevel->current.width != window->g->camera->width ||
+            toplevel->current.height != window->g->camera->height;
+    if(resized) {
         camera_update_viewport(window->g->camera, toplevel->current.width, toplevel->current.height);
-        // destroy the current depth buffer; note: we dont create the new one right away since the window may be
-        // resizing, resulting in a lot of configures in a short amount of time (before the next frame needs to be
-        // drawn). for the same reason we only draw the initial frame here, and refer to the frame events othwerwise.
-        if(window->g->depth_buffer) {
-            free(window->g->depth_buffer);
-            window->g->depth_buffer = NULL;
-        }
+    }
+    pthread_mutex_unlock(&window->g->lock);
+
+    if(resized) {
+        window_invalidate(window);
     }
 
     if(!window->mapped) {
-        render_frame(window, 0.0f);
+        // we need a buffer attached to get mapped in the first place, so this is the one time we wait for the render
+        // thread
+        ensure_buffer_pool(window);
+        submit_free_buffer(window);
+
+        struct render_target target;
+        render_thread_wait_ready(window->render_thread, &target);
+        present(window, &target);
+        window->mapped = true;
+
+        submit_free_buffer(window);
+        w_surface_request_frame(window->surface, handle_frame);
     }
 }
 
@@ -185,11 +251,30 @@ window_create(struct state* g) {
     window->toplevel->data = window;
     w_toplevel_add_listener(window->toplevel, &toplevel_listener);
 
+    window->render_thread = render_thread_create(g);
+
     return window;
 }
 
+void
+window_invalidate(struct window* window) {
+    render_thread_invalidate(window->render_thread);
+
+    // the frame callbacks start again once the window was idle, and those take care of the rest. before the window is
+    // mapped the configure does that instead
+    if(window->idle) {
+        window->idle = false;
+        ensure_buffer_pool(window);
+        submit_free_buffer(window);
+        w_surface_request_frame(window->surface, handle_frame);
+    }
+}
+
 void
 window_destroy(struct window* window) {
+    // stop drawing before any of the buffers go away
+    render_thread_destroy(window->render_thread);
+
     if(window->pointer) {
         w_pointer_destroy(window->pointer);
     }
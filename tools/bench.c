@@ -0,0 +1,267 @@
+// replays recorded camera paths over the predefined scenes and reports frame times and throughput as json lines, one
+// per benchmark, so results can be compared between versions. a benchmark can also be a single frame captured with
+// `headless -r`, which is drawn over and over without going through the scene at all
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "assets.h"
+#include "camera.h"
+#include "camera_path.h"
+#include "command_buffer.h"
+#include "framebuffer.h"
+#include "macros.h"
+#include "scene.h"
+#include "scenes.h"
+#include "time_util.h"
+
+// benchmarks of this scene replay the captured frame at their path instead of a camera path
+#define CAPTURE_SCENE "capture"
+// how many times a captured frame is drawn per pass
+#define CAPTURE_FRAMES 100
+
+struct benchmark {
+    char *scene;
+    char *path;
+};
+
+// the default suite, used when no benchmarks are given on the command line
+static struct benchmark suite[] = {
+        {"demo", "assets/paths/demo_flyby.path"},
+        {"forest", "assets/paths/forest_orbit.path"},
+        {"village", "assets/paths/village_orbit.path"},
+        {"statue", "assets/paths/statue_orbit.path"},
+};
+
+struct options {
+    int width, height;
+    // see `renderer->threads`, or -1 to leave it as it is
+    int threads;
+    // how many times the whole path is replayed, and how many frames are drawn before measuring
+    int passes, warmup;
+};
+
+static int
+compare_doubles(const void *a, const void *b) {
+    double x = *(double *)a, y = *(double *)b;
+    return (x > y) - (x < y);
+}
+
+// nearest rank percentile of an already sorted array
+static double
+percentile(double *sorted, int len, double p) {
+    int rank = (int)(p / 100.0 * len + 0.5);
+    return sorted[clamp(rank - 1, 0, len - 1)];
+}
+
+// moves the camera along the path, a captured frame always keeps the camera it was recorded with
+static void
+prepare_frame(struct camera_path *path, struct command_buffer *capture, int frame, struct camera *camera) {
+    if(!capture) {
+        camera_path_apply(path, frame, camera);
+    }
+}
+
+static void
+render_frame(struct framebuffer *framebuffer, struct scene_tree *scene, struct command_buffer *capture,
+        struct camera *camera) {
+    if(capture) {
+        framebuffer_render_commands(framebuffer, capture, camera);
+    } else {
+        framebuffer_render(framebuffer, scene, camera);
+    }
+}
+
+static bool
+run_benchmark(struct benchmark *benchmark, struct options *options) {
+    struct camera_path path = {0};
+    struct command_buffer commands = {0};
+    struct command_buffer *capture = strcmp(benchmark->scene, CAPTURE_SCENE) == 0 ? &commands : NULL;
+    if(!capture && !camera_path_load(&path, benchmark->path)) {
+        fprintf(stderr, "failed to load camera path '%s'\n", benchmark->path);
+        return false;
+    }
+
+    struct camera *camera = camera_create(M_PI_2, 1.0f / 4096.0f, 4.0f);
+    struct scene_tree *scene = scene_add_tree(NULL);
+    struct assets_manager *assets = assets_manager_create();
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bool loaded;
+    if(capture) {
+        loaded = command_buffer_read(capture, assets, benchmark->path);
+        if(loaded) {
+            command_buffer_apply_camera(capture, camera);
+        }
+    } else {
+        loaded = scenes_load(benchmark->scene, scene, assets, camera);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double load_ms = time_delta_ms(&end, &start);
+
+    if(!loaded) {
+        fprintf(stderr, "failed to load %s '%s'\n", capture ? "capture" : "scene",
+                capture ? benchmark->path : benchmark->scene);
+        scene_node_remove(&scene->node);
+        assets_manager_destroy(assets);
+        camera_destroy(camera);
+        camera_path_deinit(&path);
+        return false;
+    }
+
+    struct framebuffer *framebuffer = framebuffer_create(options->width, options->height);
+    if(options->threads >= 0) {
+        framebuffer->renderer->threads = options->threads;
+    }
+
+    for(int i = 0; i < options->warmup; i++) {
+        prepare_frame(&path, capture, i, camera);
+        render_frame(framebuffer, scene, capture, camera);
+    }
+
+    int frames = (capture ? CAPTURE_FRAMES : path.keys.len) * options->passes;
+    double *times = alloc(frames * sizeof(*times));
+    double total_ms = 0.0;
+    u64 triangles = 0, pixels = 0;
+    struct render_stats stats = {0};
+
+    for(int i = 0; i < frames; i++) {
+        prepare_frame(&path, capture, i, camera);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        render_frame(framebuffer, scene, capture, camera);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        times[i] = time_delta_ms(&end, &start);
+        total_ms += times[i];
+        struct render_stats *frame_stats = &framebuffer->renderer->stats;
+        triangles += frame_stats->triangles_submitted;
+        pixels += frame_stats->pixels_shaded;
+        render_stats_accumulate(&stats, frame_stats);
+    }
+
+    qsort(times, frames, sizeof(*times), compare_doubles);
+
+    // the mean time of each pipeline stage, as measured by the renderer itself
+    char stages[512];
+    int len = 0;
+    for(int i = 0; i < RENDER_STAGE_COUNT; i++) {
+        len += snprintf(stages + len, sizeof(stages) - len, "%s\"%s\": %.3f", i == 0 ? "" : ", ",
+                render_stage_name(i), stats.stage_ms[i] / frames);
+    }
+
+    // how much of the work was thrown away at each step, per frame
+    char counters[512];
+    snprintf(counters, sizeof(counters),
+            "\"triangles_submitted\": %llu, \"triangles_frustum_culled\": %llu, "
+            "\"triangles_backface_culled\": %llu, \"triangles_zero_area\": %llu, \"triangles_rasterized\": %llu, "
+            "\"pixels_tested\": %llu, \"pixels_depth_passed\": %llu, \"pixels_shaded\": %llu",
+            (unsigned long long)(stats.triangles_submitted / frames),
+            (unsigned long long)(stats.triangles_frustum_culled / frames),
+            (unsigned long long)(stats.triangles_backface_culled / frames),
+            (unsigned long long)(stats.triangles_zero_area / frames),
+            (unsigned long long)(stats.triangles_rasterized / frames),
+            (unsigned long long)(stats.pixels_tested / frames),
+            (unsigned long long)(stats.pixels_depth_passed / frames),
+            (unsigned long long)(stats.pixels_shaded / frames));
+
+    double seconds = total_ms / 1000.0;
+    struct thread_pool *pool = framebuffer->renderer->pool;
+    int threads = pool ? thread_pool_concurrency(pool) : 1;
+    printf("{\"scene\": \"%s\", \"path\": \"%s\", \"width\": %d, \"height\": %d, \"isa\": \"%s\", \"threads\": %d, "
+           "\"frames\": %d, \"load_ms\": %.3f, \"ms_per_frame\": {\"min\": %.3f, \"mean\": %.3f, \"p50\": %.3f, "
+           "\"p90\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f}, \"triangles_per_second\": %.0f, "
+           "\"shaded_mpixels_per_second\": %.3f, \"stage_ms\": {%s}, \"per_frame\": {%s}}\n",
+            benchmark->scene, benchmark->path, options->width, options->height, framebuffer->renderer->kernels->name,
+            threads, frames, load_ms, times[0], total_ms / frames, percentile(times, frames, 50),
+            percentile(times, frames, 90), percentile(times, frames, 95), percentile(times, frames, 99),
+            times[frames - 1], triangles / seconds, pixels / seconds / 1e6, stages, counters);
+    fflush(stdout);
+
+    free(times);
+    command_buffer_deinit(&commands);
+    framebuffer_destroy(framebuffer);
+    scene_node_remove(&scene->node);
+    assets_manager_destroy(assets);
+    camera_destroy(camera);
+    camera_path_deinit(&path);
+
+    return true;
+}
+
+static void
+usage(char *name) {
+    fprintf(stderr, "usage: %s [-w width] [-h height] [-p passes] [-W warmup] [-t threads] [scene:path ...]\n", name);
+}
+
+int
+main(int argc, char **argv) {
+    struct options options = {
+            .width = 800,
+            .height = 600,
+            // whatever the renderer picks by default
+            .threads = -1,
+            .passes = 1,
+            .warmup = 10,
+    };
+
+    int opt;
+    while((opt = getopt(argc, argv, "w:h:p:W:t:")) != -1) {
+        switch(opt) {
+            case 'w': {
+                options.width = atoi(optarg);
+                break;
+            }
+            case 'h': {
+                options.height = atoi(optarg);
+                break;
+            }
+            case 'p': {
+                options.passes = atoi(optarg);
+                break;
+            }
+            case 'W': {
+                options.warmup = atoi(optarg);
+                break;
+            }
+            case 't': {
+                options.threads = atoi(optarg);
+                break;
+            }
+            default: {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+    }
+
+    if(options.width <= 0 || options.height <= 0 || options.passes <= 0 || options.warmup < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    bool ok = true;
+    if(optind == argc) {
+        for(size_t i = 0; i < sizeof(suite) / sizeof(suite[0]); i++) {
+            ok &= run_benchmark(&suite[i], &options);
+        }
+    } else {
+        for(int i = optind; i < argc; i++) {
+            char *separator = strchr(argv[i], ':');
+            if(!separator) {
+                usage(argv[0]);
+                return 1;
+            }
+
+            *separator = 0;
+            struct benchmark benchmark = {argv[i], separator + 1};
+            ok &= run_benchmark(&benchmark, &options);
+        }
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,160 @@
+// renders a scene into an offscreen framebuffer, without needing a compositor or a display
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assets.h"
+#include "camera.h"
+#include "command_buffer.h"
+#include "framebuffer.h"
+#include "scene.h"
+#include "scenes.h"
+#include "time_util.h"
+
+static void
+usage(char *name) {
+    fprintf(stderr,
+            "usage: %s [-s scene] [-w width] [-h height] [-n frames] [-c x,y,z,pitch,yaw] "
+            "[-v shaded|overdraw|albedo|normals] [-r record.cmd] [-R replay.cmd] [-o out.ppm|out.png]\n",
+            name);
+}
+
+int
+main(int argc, char **argv) {
+    char *scene_name = "demo";
+    char *output = NULL;
+    // where to write the commands of the last frame, and commands to draw instead of the scene
+    char *record = NULL, *replay = NULL;
+    int width = 800, height = 600, frames = 1;
+    enum render_view view = RENDER_VIEW_SHADED;
+
+    struct camera *camera = camera_create(M_PI_2, 1.0f / 4096.0f, 4.0f);
+    bool has_camera = false;
+    vec3 pos;
+    float pitch, yaw;
+
+    int opt;
+    while((opt = getopt(argc, argv, "s:w:h:n:c:o:v:r:R:")) != -1) {
+        switch(opt) {
+            case 's': {
+                scene_name = optarg;
+                break;
+            }
+            case 'w': {
+                width = atoi(optarg);
+                break;
+            }
+            case 'h': {
+                height = atoi(optarg);
+                break;
+            }
+            case 'n': {
+                frames = atoi(optarg);
+                break;
+            }
+            case 'o': {
+                output = optarg;
+                break;
+            }
+            case 'r': {
+                record = optarg;
+                break;
+            }
+            case 'R': {
+                replay = optarg;
+                break;
+            }
+            case 'v': {
+                if(strcmp(optarg, "shaded") == 0) {
+                    view = RENDER_VIEW_SHADED;
+                } else if(strcmp(optarg, "overdraw") == 0) {
+                    view = RENDER_VIEW_OVERDRAW;
+                } else if(strcmp(optarg, "albedo") == 0) {
+                    view = RENDER_VIEW_ALBEDO;
+                } else if(strcmp(optarg, "normals") == 0) {
+                    view = RENDER_VIEW_NORMALS;
+                } else {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            }
+            case 'c': {
+                if(sscanf(optarg, "%f,%f,%f,%f,%f", &pos.x, &pos.y, &pos.z, &pitch, &yaw) != 5) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                has_camera = true;
+                break;
+            }
+            default: {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+    }
+
+    if(width <= 0 || height <= 0 || frames <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    struct scene_tree *scene = scene_add_tree(NULL);
+    struct assets_manager *assets = assets_manager_create();
+    struct command_buffer commands = {0};
+    if(replay) {
+        if(!command_buffer_read(&commands, assets, replay)) {
+            fprintf(stderr, "failed to read commands from '%s'\n", replay);
+            return 1;
+        }
+        command_buffer_apply_camera(&commands, camera);
+    } else if(!scenes_load(scene_name, scene, assets, camera)) {
+        fprintf(stderr, "failed to load scene '%s'\n", scene_name);
+        return 1;
+    }
+
+    if(has_camera) {
+        camera->pos = pos;
+        camera_set_orientation(camera, pitch, yaw);
+    }
+
+    struct framebuffer *framebuffer = framebuffer_create(width, height);
+    renderer_set_view(framebuffer->renderer, view);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(int i = 0; i < frames; i++) {
+        if(replay) {
+            framebuffer_render_commands(framebuffer, &commands, camera);
+        } else if(record && i == frames - 1) {
+            framebuffer_record(framebuffer, scene, camera, &commands);
+        } else {
+            framebuffer_render(framebuffer, scene, camera);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    printf("%d frames at %dx%d with %s kernels, %.3f ms/frame\n", frames, width, height,
+            framebuffer->renderer->kernels->name, time_delta_ms(&end, &start) / frames);
+    render_stats_print(stdout, &framebuffer->renderer->stats);
+
+    int ret = 0;
+    if(output && !framebuffer_write(framebuffer, output)) {
+        fprintf(stderr, "failed to write '%s'\n", output);
+        ret = 1;
+    }
+    if(record && !replay && !command_buffer_write(&commands, record)) {
+        fprintf(stderr, "failed to write '%s'\n", record);
+        ret = 1;
+    }
+
+    command_buffer_deinit(&commands);
+    framebuffer_destroy(framebuffer);
+    scene_node_remove(&scene->node);
+    assets_manager_destroy(assets);
+    camera_destroy(camera);
+
+    return ret;
+}
@@ -55,7 +55,7 @@
     }                                                                                                   \
                                                                                                         \
     static inline void prefix##_remove_fast(prefix##_t *array, int index) {                             \
-        array[index] = array[array->len - 1];                                                           \
+        array->data[index] = array->data[array->len - 1];                                               \
         array->len--;                                                                                   \
     }                                                                                                   \
                                                                                                         \
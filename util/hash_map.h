@@ -0,0 +1,142 @@
+#ifndef HASH_MAP_H
+#define HASH_MAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// an open addressing hash map with linear probing, in the same spirit as `define_array()`. `hash` gets a pointer to a
+// key and returns a `uint64_t`, `equal` gets pointers to two keys. the map never owns whatever the keys point to
+
+#ifndef HASH_MAP_DEFAULT_CAP
+#define HASH_MAP_DEFAULT_CAP 16
+#endif
+
+// fnv-1a, good enough for names and paths
+static inline uint64_t
+hash_bytes(const void *data, size_t len) {
+    const unsigned char *p = data;
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for(size_t i = 0; i < len; i++) {
+        hash = (hash ^ p[i]) * 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+// the finalizer of splitmix64, it spreads every bit of the input over the whole output
+static inline uint64_t
+hash_u64(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+
+    return x ^ (x >> 31);
+}
+
+#define define_hash_map(key_type, value_type, prefix, hash, equal)                                                  \
+    struct prefix##_entry {                                                                                         \
+        key_type key;                                                                                               \
+        value_type value;                                                                                           \
+        bool used;                                                                                                  \
+    };                                                                                                              \
+                                                                                                                    \
+    typedef struct prefix {                                                                                         \
+        int len, cap;                                                                                               \
+        struct prefix##_entry *entries;                                                                             \
+    } prefix##_t;                                                                                                   \
+                                                                                                                    \
+    static inline struct prefix##_entry *prefix##_find(prefix##_t *map, key_type *key) {                            \
+        if(map->cap == 0) {                                                                                         \
+            return NULL;                                                                                            \
+        }                                                                                                           \
+                                                                                                                    \
+        int mask = map->cap - 1;                                                                                    \
+        for(int i = hash(key) & mask;; i = (i + 1) & mask) {                                                        \
+            struct prefix##_entry *entry = &map->entries[i];                                                        \
+            if(!entry->used) {                                                                                      \
+                return NULL;                                                                                        \
+            }                                                                                                       \
+            if(equal(&entry->key, key)) {                                                                           \
+                return entry;                                                                                       \
+            }                                                                                                       \
+        }                                                                                                           \
+    }                                                                                                               \
+                                                                                                                    \
+    static inline value_type *prefix##_get(prefix##_t *map, key_type *key) {                                        \
+        struct prefix##_entry *entry = prefix##_find(map, key);                                                     \
+                                                                                                                    \
+        return entry ? &entry->value : NULL;                                                                        \
+    }                                                                                                               \
+                                                                                                                    \
+    static inline void prefix##_put(prefix##_t *map, key_type key, value_type value);                               \
+                                                                                                                    \
+    static inline void prefix##_grow(prefix##_t *map) {                                                             \
+        struct prefix##_entry *entries = map->entries;                                                              \
+        int cap = map->cap;                                                                                         \
+                                                                                                                    \
+        map->cap = cap == 0 ? HASH_MAP_DEFAULT_CAP : 2 * cap;                                                       \
+        map->len = 0;                                                                                               \
+        map->entries = calloc(map->cap, sizeof(*map->entries));                                                     \
+                                                                                                                    \
+        for(int i = 0; i < cap; i++) {                                                                              \
+            if(entries[i].used) {                                                                                   \
+                prefix##_put(map, entries[i].key, entries[i].value);                                                \
+            }                                                                                                       \
+        }                                                                                                           \
+        free(entries);                                                                                              \
+    }                                                                                                               \
+                                                                                                                    \
+    /* inserts the value, or replaces the one that is already there for this key */                                 \
+    static inline void prefix##_put(prefix##_t *map, key_type key, value_type value) {                              \
+        /* kept at most 3/4 full so the probes stay short */                                                        \
+        if(4 * (map->len + 1) > 3 * map->cap) {                                                                     \
+            prefix##_grow(map);                                                                                     \
+        }                                                                                                           \
+                                                                                                                    \
+        int mask = map->cap - 1;                                                                                    \
+        for(int i = hash(&key) & mask;; i = (i + 1) & mask) {                                                       \
+            struct prefix##_entry *entry = &map->entries[i];                                                        \
+            if(!entry->used) {                                                                                      \
+                *entry = (struct prefix##_entry){key, value, true};                                                 \
+                map->len++;                                                                                         \
+                return;                                                                                             \
+            }                                                                                                       \
+            if(equal(&entry->key, &key)) {                                                                          \
+                entry->value = value;                                                                               \
+                return;                                                                                             \
+            }                                                                                                       \
+        }                                                                                                           \
+    }                                                                                                               \
+                                                                                                                    \
+    static inline bool prefix##_remove(prefix##_t *map, key_type *key) {                                            \
+        struct prefix##_entry *entry = prefix##_find(map, key);                                                     \
+        if(!entry) {                                                                                                \
+            return false;                                                                                           \
+        }                                                                                                           \
+                                                                                                                    \
+        /* shift back the entries after it that would otherwise not be found anymore */                             \
+        int mask = map->cap - 1;                                                                                    \
+        int hole = entry - map->entries;                                                                            \
+        for(int i = (hole + 1) & mask; map->entries[i].used; i = (i + 1) & mask) {                                  \
+            int home = hash(&map->entries[i].key) & mask;                                                           \
+            if(((i - home) & mask) >= ((i - hole) & mask)) {                                                        \
+                map->entries[hole] = map->entries[i];                                                               \
+                hole = i;                                                                                           \
+            }                                                                                                       \
+        }                                                                                                           \
+        map->entries[hole].used = false;                                                                            \
+        map->len--;                                                                                                 \
+                                                                                                                    \
+        return true;                                                                                                \
+    }                                                                                                               \
+                                                                                                                    \
+    static inline void prefix##_deinit(prefix##_t *map) {                                                           \
+        free(map->entries);                                                                                         \
+    }                                                                                                               \
+                                                                                                                    \
+    struct prefix
+
+// ^ this last thing is just so we can use ; after the `define_hash_map()`, same as with `define_array()`
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// a pool of elements that never move once added, in the same spirit as `define_array()`. the elements are kept in
+// chunks of `POOL_CHUNK_SIZE`, so elements of the same type stay close together in memory however many are added and
+// removed. removed slots are reused first, and every slot counts how many times it was removed, so a handle to an
+// element that is gone can be told apart from one to whatever took its place
+
+#ifndef POOL_CHUNK_SIZE
+#define POOL_CHUNK_SIZE 256
+#endif
+
+struct pool_handle {
+    uint32_t index, generation;
+};
+
+#define define_pool(type, prefix)                                                                                   \
+    struct prefix##_slot {                                                                                          \
+        type value;                                                                                                 \
+        uint32_t index, generation;                                                                                 \
+        bool used;                                                                                                  \
+        int next_free;                                                                                              \
+    };                                                                                                              \
+                                                                                                                    \
+    typedef struct prefix {                                                                                         \
+        struct prefix##_slot **chunks;                                                                              \
+        /* how many slots were made so far, and how many of them are in use */                                      \
+        int len, used;                                                                                              \
+        /* the most recently removed slot, only valid while `used < len` */                                         \
+        int first_free;                                                                                             \
+    } prefix##_t;                                                                                                   \
+                                                                                                                    \
+    static inline struct prefix##_slot *prefix##_slot(prefix##_t *pool, int index) {                                \
+        return &pool->chunks[index / POOL_CHUNK_SIZE][index % POOL_CHUNK_SIZE];                                     \
+    }                                                                                                               \
+                                                                                                                    \
+    /* the new element is zeroed */                                                                                 \
+    static inline type *prefix##_add(prefix##_t *pool) {                                                            \
+        struct prefix##_slot *slot;                                                                                 \
+        if(pool->used < pool->len) {                                                                                \
+            slot = prefix##_slot(pool, pool->first_free);                                                           \
+            pool->first_free = slot->next_free;                                                                     \
+        } else {                                                                                                    \
+            if(pool->len % POOL_CHUNK_SIZE == 0) {                                                                  \
+                int chunks_len = pool->len / POOL_CHUNK_SIZE;                                                       \
+                pool->chunks = realloc(pool->chunks, (chunks_len + 1) * sizeof(*pool->chunks));                     \
+                pool->chunks[chunks_len] = calloc(POOL_CHUNK_SIZE, sizeof(struct prefix##_slot));                   \
+            }                                                                                                       \
+            slot = prefix##_slot(pool, pool->len);                                                                  \
+            slot->index = pool->len++;                                                                              \
+        }                                                                                                           \
+                                                                                                                    \
+        memset(&slot->value, 0, sizeof(slot->value));                                                               \
+        slot->used = true;                                                                                          \
+        pool->used++;                                                                                               \
+                                                                                                                    \
+        return &slot->value;                                                                                        \
+    }                                                                                                               \
+                                                                                                                    \
+    static inline void prefix##_remove(prefix##_t *pool, type *elem) {                                              \
+        struct prefix##_slot *slot = (struct prefix##_slot *)elem;                                                  \
+        slot->used = false;                                                                                         \
+        slot->generation++;                                                                                         \
+        slot->next_free = pool->first_free;                                                                         \
+        pool->first_free = slot->index;                                                                             \
+        pool->used--;                                                                                               \
+    }                                                                                                               \
+                                                                                                                    \
+    static inline struct pool_handle prefix##_handle(type *elem) {                                                  \
+        struct prefix##_slot *slot = (struct prefix##_slot *)elem;                                                  \
+                                                                                                                    \
+        return (struct pool_handle){slot->index, slot->generation};                                                 \
+    }                                                                                                               \
+                                                                                                                    \
+    /* the element the handle refers to, or NULL if it was removed since */                                         \
+    static inline type *prefix##_get(prefix##_t *pool, struct pool_handle handle) {                                 \
+        if(handle.index >= (uint32_t)pool->len) {                                                                   \
+            return NULL;                                                                                            \
+        }                                                                                                           \
+                                                                                                                    \
+        struct prefix##_slot *slot = prefix##_slot(pool, handle.index);                                             \
+        return slot->used && slot->generation == handle.generation ? &slot->value : NULL;                           \
+    }                                                                                                               \
+                                                                                                                    \
+    static inline void prefix##_deinit(prefix##_t *pool) {                                                          \
+        for(int i = 0; i * POOL_CHUNK_SIZE < pool->len; i++) {                                                      \
+            free(pool->chunks[i]);                                                                                  \
+        }                                                                                                           \
+        free(pool->chunks);                                                                                         \
+    }                                                                                                               \
+                                                                                                                    \
+    struct prefix
+
+// ^ this last thing is just so we can use ; after the `define_pool()`
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef QUANTIZE_H
+#define QUANTIZE_H
+
+#include <math.h>
+
+#include "ints.h"
+#include "vec2.h"
+#include "vec3.h"
+
+// vectors of 16-bit integers, for storing floats in half the space when their range is known up front. unsigned ones
+// go from 0 at the low end of the range to 65535 at the high end, see `unorm16_encode()`
+typedef struct u16vec2 {
+    u16 x, y;
+} u16vec2;
+
+typedef struct u16vec3 {
+    u16 x, y, z;
+} u16vec3;
+
+// a unit vector in octahedral form, see `octahedral_encode()`
+typedef struct i16vec2 {
+    i16 x, y;
+} i16vec2;
+
+// `v` in [0, 1], anything outside is clamped
+static inline u16
+unorm16_encode(float v) {
+    return (u16)(fminf(fmaxf(v, 0.0f), 1.0f) * 65535.0f + 0.5f);
+}
+
+// `v` in [-1, 1], anything outside is clamped
+static inline i16
+snorm16_encode(float v) {
+    return (i16)roundf(fminf(fmaxf(v, -1.0f), 1.0f) * 32767.0f);
+}
+
+static inline float
+snorm16_decode(i16 v) {
+    return v / 32767.0f;
+}
+
+// "a survey of efficient representations for independent unit vectors" by cigolle et al. the vector is projected onto
+// the octahedron |x| + |y| + |z| = 1, and the lower half of that is folded out over the corners of the upper half,
+// which leaves a square that x and y alone are enough to address. `v` does not need to be normalized, the zero vector
+// comes out as pointing along z
+static inline i16vec2
+octahedral_encode(vec3 v) {
+    float l1 = fabsf(v.x) + fabsf(v.y) + fabsf(v.z);
+    if(l1 == 0.0f) {
+        return (i16vec2){0, 0};
+    }
+
+    float x = v.x / l1, y = v.y / l1;
+    if(v.z < 0.0f) {
+        float folded_x = copysignf(1.0f - fabsf(y), x);
+        y = copysignf(1.0f - fabsf(x), y);
+        x = folded_x;
+    }
+
+    return (i16vec2){snorm16_encode(x), snorm16_encode(y)};
+}
+
+// the result is on the octahedron rather than the unit sphere, normalize it if the length matters
+static inline vec3
+octahedral_decode(i16vec2 v) {
+    float x = snorm16_decode(v.x), y = snorm16_decode(v.y);
+    float z = 1.0f - fabsf(x) - fabsf(y);
+
+    // unfolds the lower half, the points of the upper half have a z of at least 0 and stay where they are
+    float t = fmaxf(-z, 0.0f);
+    return (vec3){x - copysignf(t, x), y - copysignf(t, y), z};
+}
+
+#endif
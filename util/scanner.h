@@ -0,0 +1,180 @@
+#ifndef SCANNER_H
+#define SCANNER_H
+
+// a tokenizer over a block of memory that is already loaded (usually a memory mapped file). nothing is copied or
+// allocated: lines and tokens are views into the original memory, which does not need to be NUL terminated
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct scanner {
+    char *cur, *end;
+};
+
+// a piece of the scanned memory
+struct token {
+    char *data;
+    int len;
+};
+
+static inline void
+scanner_init(struct scanner *s, char *data, size_t len) {
+    s->cur = data;
+    s->end = data + len;
+}
+
+static inline bool
+scanner_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// moves `line` over the next line, without the line ending. returns false once everything was read
+static inline bool
+scanner_next_line(struct scanner *s, struct scanner *line) {
+    if(s->cur >= s->end) {
+        return false;
+    }
+
+    char *newline = memchr(s->cur, '\n', s->end - s->cur);
+    char *end = newline ? newline : s->end;
+
+    line->cur = s->cur;
+    line->end = end;
+    s->cur = newline ? newline + 1 : s->end;
+
+    return true;
+}
+
+// the next run of non space characters. returns false if there is none left
+static inline bool
+scanner_next_token(struct scanner *s, struct token *dest) {
+    char *p = s->cur;
+    while(p < s->end && scanner_is_space(*p)) {
+        p++;
+    }
+
+    char *start = p;
+    while(p < s->end && !scanner_is_space(*p)) {
+        p++;
+    }
+
+    s->cur = p;
+    dest->data = start;
+    dest->len = p - start;
+
+    return dest->len > 0;
+}
+
+static inline bool
+token_equal_c_string(struct token *t, char *s) {
+    int len = strlen(s);
+
+    return t->len == len && memcmp(t->data, s, len) == 0;
+}
+
+// parses an optionally signed decimal integer at the start of the token, and drops the characters it used from it.
+// returns false if there are no digits
+static inline bool
+token_parse_int(struct token *t, int *dest) {
+    char *p = t->data, *end = t->data + t->len;
+
+    bool negative = false;
+    if(p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    char *digits = p;
+    int value = 0;
+    while(p < end && *p >= '0' && *p <= '9') {
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+
+    if(p == digits) {
+        return false;
+    }
+
+    *dest = negative ? -value : value;
+    t->len -= p - t->data;
+    t->data = p;
+
+    return true;
+}
+
+// parses the whole token as a floating point number, giving the same result as `atof()`
+static inline bool
+token_parse_float(struct token *t, float *dest) {
+    // exactly representable powers of ten
+    static const double powers[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+
+    char *p = t->data, *end = t->data + t->len;
+
+    bool negative = false;
+    if(p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool any = false;
+    for(; p < end && *p >= '0' && *p <= '9'; p++) {
+        any = true;
+        if(mantissa == 0 && *p == '0') {
+            continue;
+        }
+        mantissa = mantissa * 10 + (*p - '0');
+        digits++;
+    }
+    if(p < end && *p == '.') {
+        p++;
+        for(; p < end && *p >= '0' && *p <= '9'; p++) {
+            any = true;
+            if(mantissa == 0 && *p == '0') {
+                exponent--;
+                continue;
+            }
+            mantissa = mantissa * 10 + (*p - '0');
+            digits++;
+            exponent--;
+        }
+    }
+    if(any && p < end && (*p == 'e' || *p == 'E')) {
+        struct token rest = {p + 1, end - p - 1};
+        int e;
+        if(token_parse_int(&rest, &e)) {
+            exponent += e;
+            p = rest.data;
+        }
+    }
+
+    // when both the mantissa and the power of ten are exact doubles, a single multiplication or division is correctly
+    // rounded. everything else (long mantissas, huge exponents, "inf", "nan", ...) goes through the c library
+    if(any && p == end && digits <= 15 && exponent >= -22 && exponent <= 22) {
+        double value = (double)mantissa;
+        value = exponent < 0 ? value / powers[-exponent] : value * powers[exponent];
+        *dest = negative ? -value : value;
+
+        return true;
+    }
+
+    char buffer[64];
+    if(t->len >= (int)sizeof(buffer)) {
+        return false;
+    }
+    memcpy(buffer, t->data, t->len);
+    buffer[t->len] = '\0';
+
+    char *parsed;
+    *dest = strtod(buffer, &parsed);
+
+    return parsed != buffer;
+}
+
+#endif
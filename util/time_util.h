@@ -4,6 +4,13 @@
 #include <stdint.h>
 #include <time.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TIME_HAS_TSC 1
+#else
+#define TIME_HAS_TSC 0
+#endif
+
 static inline uint32_t
 time_from_timespec_ms(struct timespec *ts) {
     return ts->tv_sec * 1000 + ts->tv_nsec / 1000000;
@@ -32,4 +39,35 @@ time_delta_ms(struct timespec *a, struct timespec *b) {
     return time_delta_ns(a, b) / 1000000.0F;
 }
 
+// a cheap timestamp for measuring short intervals. on x86 this reads the time stamp counter, which costs a fraction of
+// a `clock_gettime()` call. the value only means something relative to other ticks, see `time_ticks_to_ms()`
+static inline uint64_t
+time_ticks(void) {
+#if TIME_HAS_TSC
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return time_from_timespec_ns(&ts);
+#endif
+}
+
+#if TIME_HAS_TSC
+// how many ticks make a millisecond. calibrated against the monotonic clock the first time it is needed, once for the
+// whole process, see `time_util.c`
+double
+time_ticks_per_ms(void);
+#else
+static inline double
+time_ticks_per_ms(void) {
+    return 1000000.0;
+}
+#endif
+
+static inline double
+time_ticks_to_ms(uint64_t ticks) {
+    return ticks / time_ticks_per_ms();
+}
+
 #endif